@@ -1,6 +1,8 @@
 TEMPLATE = subdirs
 
-SUBDIRS += src doc
+SUBDIRS += src doc tests
+
+tests.depends = src
 
 no-qml {
     message(Building without QML dependency.)
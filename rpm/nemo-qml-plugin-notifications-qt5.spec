@@ -1,6 +1,6 @@
 Name:       nemo-qml-plugin-notifications-qt5
 Summary:    Notifications plugin for Nemo Mobile
-Version:    1.2.23
+Version:    2.0.0
 Release:    1
 License:    BSD
 URL:        https://github.com/sailfishos/nemo-qml-plugin-notifications/
@@ -11,6 +11,7 @@ BuildRequires:  pkgconfig(Qt5Core)
 BuildRequires:  pkgconfig(Qt5Gui)
 BuildRequires:  pkgconfig(Qt5Qml)
 BuildRequires:  pkgconfig(Qt5DBus)
+BuildRequires:  pkgconfig(Qt5Test)
 BuildRequires:  sailfish-qdoc-template
 
 %description
@@ -23,6 +24,13 @@ Requires:   %{name} = %{version}-%{release}
 %description devel
 %{summary}.
 
+%package tests
+Summary:    Unit tests for %{name}
+Requires:   %{name} = %{version}-%{release}
+
+%description tests
+%{summary}.
+
 %package doc
 Summary: Documentation for %{name}
 BuildRequires: qt5-qttools-qthelp-devel
@@ -72,6 +80,10 @@ sed 's/Nemo.Notifications/org.nemomobile.notifications/' < src/plugin/qmldir > %
 %{_includedir}/nemonotifications-qt5
 %{_libdir}/pkgconfig/nemonotifications-qt5.pc
 
+%files tests
+%defattr(-,root,root,-)
+/opt/tests/nemo-qml-plugin-notifications-qt5
+
 %files doc
 %defattr(-,root,root,-)
 %{_docdir}/%{name}
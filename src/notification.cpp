@@ -32,40 +32,63 @@
 #include "notificationmanagerproxy.h"
 #include "notification.h"
 #include "notification_p.h"
-
+#include "notificationduplicatefilter_p.h"
+#include "notificationgroups_p.h"
+#include "notificationhints_p.h"
+#include "notificationlistingcache_p.h"
+#include "notificationofflinequeue_p.h"
+#include "notificationpublishscheduler_p.h"
+#include "notificationpublishstatistics_p.h"
+#include "notificationqueue.h"
+#include "notificationtable.h"
+
+#include <QDBusPendingCallWatcher>
+#include <QDBusServiceWatcher>
+#include <QFutureWatcher>
 #include <QImage>
+#include <QMutex>
+#include <QRunnable>
+#include <QTimer>
 #include <QStringBuilder>
+#include <QThreadPool>
 #include <QDebug>
 
+#include <algorithm>
+
+#include <string.h>
 #include <time.h>
 
 #define DBUS_SERVICE "org.freedesktop.Notifications"
 #define DBUS_PATH "/org/freedesktop/Notifications"
+#define DBUS_STATISTICS_PATH "/org/nemomobile/NotificationStatistics"
+
+// Hint names are static QString data, so that using them as keys does not allocate
+const QString HINT_CATEGORY = QStringLiteral("category");
+const QString HINT_ITEM_COUNT = QStringLiteral("x-nemo-item-count");
+const QString HINT_TIMESTAMP = QStringLiteral("x-nemo-timestamp");
+const QString HINT_OWNER = QStringLiteral("x-nemo-owner");
 
 namespace {
 
-const char *HINT_CATEGORY = "category";
-const char *HINT_URGENCY = "urgency";
-const char *HINT_TRANSIENT = "transient";
-const char *HINT_RESIDENT = "resident";
-const char *HINT_ITEM_COUNT = "x-nemo-item-count";
-const char *HINT_TIMESTAMP = "x-nemo-timestamp";
-const char *HINT_PREVIEW_BODY = "x-nemo-preview-body";
-const char *HINT_PREVIEW_SUMMARY = "x-nemo-preview-summary";
-const char *HINT_SUB_TEXT = "x-nemo-sub-text";
-const char *HINT_REMOTE_ACTION_PREFIX = "x-nemo-remote-action-";
-const char *HINT_REMOTE_ACTION_ICON_PREFIX = "x-nemo-remote-action-icon-";
-const char *HINT_REMOTE_ACTION_INPUT_PREFIX = "x-nemo-remote-action-input-";
-const char *HINT_REMOTE_ACTION_TYPE_PREFIX = "x-nemo-remote-action-type-";
-const char *HINT_ORIGIN = "x-nemo-origin";
-const char *HINT_OWNER = "x-nemo-owner";
-const char *HINT_MAX_CONTENT_LINES = "x-nemo-max-content-lines";
-const char *DEFAULT_ACTION_NAME = "default";
-const char *HINT_PROGRESS = "x-nemo-progress";
-const char *HINT_SOUND_FILE = "sound-file";
-const char *HINT_SOUND_NAME = "sound-name";
-const char *HINT_IMAGE_DATA = "image-data";
-const char *HINT_IMAGE_PATH = "image-path";
+const QString HINT_URGENCY = QStringLiteral("urgency");
+const QString HINT_TRANSIENT = QStringLiteral("transient");
+const QString HINT_RESIDENT = QStringLiteral("resident");
+const QString HINT_PREVIEW_BODY = QStringLiteral("x-nemo-preview-body");
+const QString HINT_PREVIEW_SUMMARY = QStringLiteral("x-nemo-preview-summary");
+const QString HINT_SUB_TEXT = QStringLiteral("x-nemo-sub-text");
+const QString HINT_REMOTE_ACTION_PREFIX = QStringLiteral("x-nemo-remote-action-");
+const QString HINT_REMOTE_ACTION_ICON_PREFIX = QStringLiteral("x-nemo-remote-action-icon-");
+const QString HINT_REMOTE_ACTION_INPUT_PREFIX = QStringLiteral("x-nemo-remote-action-input-");
+const QString HINT_REMOTE_ACTION_TYPE_PREFIX = QStringLiteral("x-nemo-remote-action-type-");
+const QString HINT_ORIGIN = QStringLiteral("x-nemo-origin");
+const QString HINT_MAX_CONTENT_LINES = QStringLiteral("x-nemo-max-content-lines");
+const QString DEFAULT_ACTION_NAME = QStringLiteral("default");
+const QString HINT_PROGRESS = QStringLiteral("x-nemo-progress");
+const QString HINT_SOUND_FILE = QStringLiteral("sound-file");
+const QString HINT_SOUND_NAME = QStringLiteral("sound-name");
+const QString HINT_IMAGE_DATA = QStringLiteral("image-data");
+const QString HINT_IMAGE_PATH = QStringLiteral("image-path");
+const QString HINT_GROUP_ID = QStringLiteral("x-nemo-group-id");
 
 class NotificationImage : public QImage
 {
@@ -117,22 +140,48 @@ static inline QString processName() {
 
 Q_GLOBAL_STATIC(NotificationConnectionManager, connMgr)
 
-NotificationManagerProxy *notificationManager()
+typedef QHash<QString, QSharedPointer<NotificationConnectionManager> > ConnectionManagerHash;
+Q_GLOBAL_STATIC(ConnectionManagerHash, connMgrs)
+
+Q_GLOBAL_STATIC(QSet<QString>, internedStrings)
+Q_GLOBAL_STATIC(QMutex, internedStringsMutex)
+
+// The application name and icon are common to many notifications; share a single copy of them.
+// Interned strings are never released, so only values from a small, fixed set should be interned.
+// Notifications may be created on any thread, so the pool is shared under a lock
+QString intern(const QString &string)
 {
-    if (connMgr()->proxy.isNull()) {
-        qDBusRegisterMetaType<NotificationData>();
-        qDBusRegisterMetaType<QList<NotificationData> >();
-        qDBusRegisterMetaType<NotificationImage>();
-        QString serviceName(DBUS_SERVICE);
-        QDBusConnection *conn = connMgr()->dBusConnection.data();
-        if (conn && conn->isConnected() && conn->baseService().isEmpty()) {
-            // p2p connection - no service name
-            serviceName.clear();
-        }
-        connMgr()->proxy.reset(new NotificationManagerProxy(serviceName, DBUS_PATH, 
-                        conn ? *conn : QDBusConnection::sessionBus()));
+    if (string.isEmpty()) {
+        return string;
+    }
+
+    QMutexLocker locker(internedStringsMutex());
+    QSet<QString> *strings = internedStrings();
+    QSet<QString>::const_iterator it = strings->constFind(string);
+    if (it != strings->constEnd()) {
+        return *it;
     }
-    return connMgr()->proxy.data();
+
+    // Take a deep copy, in case the string refers to data we do not own
+    const QString copy(string.constData(), string.size());
+    strings->insert(copy);
+    return copy;
+}
+
+const NotificationData &defaultData()
+{
+    // Shared by all new notifications, until they are modified
+    static const NotificationData data = []() {
+        NotificationData rv;
+        rv.setHint(HINT_URGENCY, static_cast<int>(Notification::Normal));
+        return rv;
+    }();
+    return data;
+}
+
+inline QString actionHintName(const QString &prefix, const QString &actionName)
+{
+    return prefix % actionName;
 }
 
 QString encodeDBusCall(const QString &service, const QString &path, const QString &iface, const QString &method, const QVariantList &arguments)
@@ -195,59 +244,204 @@ QList<NotificationData::ActionInfo> decodeActions(const QStringList &actions)
     return rv;
 }
 
-QPair<QList<NotificationData::ActionInfo>, QVariantHash> encodeActionHints(const QVariantList &actions)
-{
-    QPair<QList<NotificationData::ActionInfo>, QVariantHash> rv;
-    foreach (const QVariant &action, actions) {
-        QVariantMap vm = action.value<QVariantMap>();
-        const QString actionName = vm["name"].value<QString>();
-        if (!actionName.isEmpty()) {
-            const QString displayName = vm["displayName"].value<QString>();
-            const QString service = vm["service"].value<QString>();
-            const QString path = vm["path"].value<QString>();
-            const QString iface = vm["iface"].value<QString>();
-            const QString method = vm["method"].value<QString>();
-            const QVariantList arguments = vm["arguments"].value<QVariantList>();
-            const QString icon = vm["icon"].value<QString>();
-            const QVariantMap input = vm["input"].value<QVariantMap>();
-            QString type = vm["type"].value<QString>();
-
-            const NotificationData::ActionInfo actionInfo = { actionName, displayName };
-            rv.first.append(actionInfo);
-
-            if (!service.isEmpty() && !path.isEmpty() && !iface.isEmpty() && !method.isEmpty()) {
-                rv.second.insert(QString(HINT_REMOTE_ACTION_PREFIX) + actionName, encodeDBusCall(service, path, iface, method, arguments));
-            }
-            if (!icon.isEmpty()) {
-                rv.second.insert(QString(HINT_REMOTE_ACTION_ICON_PREFIX) + actionName, icon);
-            }
-            if (!input.isEmpty()) {
-                rv.second.insert(QString(HINT_REMOTE_ACTION_INPUT_PREFIX) + actionName, input);
-                if (type.isEmpty()) {
-                    type = QLatin1String("input");
-                }
-            }
-            if (!type.isEmpty()) {
-                rv.second.insert(QString(HINT_REMOTE_ACTION_TYPE_PREFIX) + actionName, type);
+bool isServiceUnavailable(const QDBusError &error)
+{
+    return error.type() == QDBusError::ServiceUnknown || error.type() == QDBusError::NameHasNoOwner;
+}
+
+// Decoded form of a remote action specification
+struct RemoteAction
+{
+    enum HintName {
+        CallHint,
+        IconHint,
+        InputHint,
+        TypeHint
+    };
+
+    // The specification as it was set, if the action was not decoded from hints
+    QVariant specification;
+    QString name;
+    QString displayName;
+    QString icon;
+    QString service;
+    QString path;
+    QString iface;
+    QString method;
+    QVariantList arguments;
+    QString type;
+    QVariantMap input;
+    QSet<QString> choices;
+    bool hasInput = false;
+    bool hasChoices = false;
+    bool editable = false;
+    // The hints representing this action, kept until the action changes
+    QVariantHash encodedHints;
+    // The names of the hints that may represent this action, in HintName order
+    QStringList hintNames;
+
+    static RemoteAction fromVariant(const QVariant &variant)
+    {
+        const QVariantMap vm(variant.toMap());
+
+        RemoteAction action;
+        action.specification = variant;
+        action.setName(vm.value(QStringLiteral("name")).toString());
+        action.displayName = vm.value(QStringLiteral("displayName")).toString();
+        action.icon = vm.value(QStringLiteral("icon")).toString();
+        action.service = vm.value(QStringLiteral("service")).toString();
+        action.path = vm.value(QStringLiteral("path")).toString();
+        action.iface = vm.value(QStringLiteral("iface")).toString();
+        action.method = vm.value(QStringLiteral("method")).toString();
+        action.arguments = vm.value(QStringLiteral("arguments")).toList();
+        action.type = vm.value(QStringLiteral("type")).toString();
+
+        QVariantMap::const_iterator it = vm.constFind(QStringLiteral("input"));
+        if (it != vm.constEnd()) {
+            action.setInput(it.value().toMap());
+        }
+        return action;
+    }
+
+    void setName(const QString &actionName)
+    {
+        name = actionName;
+        hintNames.clear();
+        if (!name.isEmpty()) {
+            hintNames << actionHintName(HINT_REMOTE_ACTION_PREFIX, name)
+                      << actionHintName(HINT_REMOTE_ACTION_ICON_PREFIX, name)
+                      << actionHintName(HINT_REMOTE_ACTION_INPUT_PREFIX, name)
+                      << actionHintName(HINT_REMOTE_ACTION_TYPE_PREFIX, name);
+        }
+    }
+
+    void setInput(const QVariantMap &map)
+    {
+        input = map;
+        hasInput = true;
+
+        // The choices are resolved once, rather than on each invocation
+        QVariantMap::const_iterator it = input.constFind(QStringLiteral("choices"));
+        hasChoices = (it != input.constEnd());
+        choices.clear();
+        if (hasChoices) {
+            for (const QString &choice : it.value().toStringList()) {
+                choices.insert(choice);
             }
         }
+        editable = input.value(QStringLiteral("editable")).toBool();
+    }
+
+    bool acceptsInput(const QString &text) const
+    {
+        return !text.isEmpty() && (!hasChoices || editable || choices.contains(text));
+    }
+
+    int callbackParameters() const
+    {
+        return (service.isEmpty() ? 0 : 1) + (path.isEmpty() ? 0 : 1)
+                + (iface.isEmpty() ? 0 : 1) + (method.isEmpty() ? 0 : 1);
+    }
+
+    QVariantMap toVariantMap() const
+    {
+        QVariantMap vm;
+        vm.insert(QStringLiteral("name"), name);
+        vm.insert(QStringLiteral("displayName"), displayName);
+        if (!icon.isEmpty()) {
+            vm.insert(QStringLiteral("icon"), icon);
+        }
+        if (!service.isEmpty()) {
+            vm.insert(QStringLiteral("service"), service);
+        }
+        if (!path.isEmpty()) {
+            vm.insert(QStringLiteral("path"), path);
+        }
+        if (!iface.isEmpty()) {
+            vm.insert(QStringLiteral("iface"), iface);
+        }
+        if (!method.isEmpty()) {
+            vm.insert(QStringLiteral("method"), method);
+        }
+        if (!arguments.isEmpty() || callbackParameters() == 4) {
+            vm.insert(QStringLiteral("arguments"), arguments);
+        }
+        if (!type.isEmpty()) {
+            vm.insert(QStringLiteral("type"), type);
+        }
+        if (hasInput) {
+            vm.insert(QStringLiteral("input"), input);
+        }
+        return vm;
+    }
+
+    QVariant toVariant() const
+    {
+        return specification.isValid() ? specification : QVariant(toVariantMap());
+    }
+
+    bool operator==(const RemoteAction &other) const
+    {
+        return name == other.name
+                && displayName == other.displayName
+                && icon == other.icon
+                && service == other.service
+                && path == other.path
+                && iface == other.iface
+                && method == other.method
+                && arguments == other.arguments
+                && type == other.type
+                && hasInput == other.hasInput
+                && input == other.input;
+    }
+
+    bool operator!=(const RemoteAction &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+QVariantHash encodeActionHints(const RemoteAction &action)
+{
+    QVariantHash rv;
+    if (action.hintNames.isEmpty()) {
+        return rv;
+    }
+
+    if (action.callbackParameters() == 4) {
+        rv.insert(action.hintNames.at(RemoteAction::CallHint),
+                  encodeDBusCall(action.service, action.path, action.iface, action.method, action.arguments));
+    }
+    if (!action.icon.isEmpty()) {
+        rv.insert(action.hintNames.at(RemoteAction::IconHint), action.icon);
+    }
+    QString type = action.type;
+    if (!action.input.isEmpty()) {
+        rv.insert(action.hintNames.at(RemoteAction::InputHint), action.input);
+        if (type.isEmpty()) {
+            type = QLatin1String("input");
+        }
+    }
+    if (!type.isEmpty()) {
+        rv.insert(action.hintNames.at(RemoteAction::TypeHint), type);
     }
 
     return rv;
 }
 
-QVariantList decodeActionHints(const QList<NotificationData::ActionInfo> &actions, const QVariantHash &hints)
+QList<RemoteAction> decodeActionHints(const QList<NotificationData::ActionInfo> &actions, const QVariantHash &hints)
 {
-    QVariantList rv;
+    QList<RemoteAction> rv;
 
     for (const NotificationData::ActionInfo &actionInfo : actions) {
-        const QString &actionName = actionInfo.name;
-        const QString &displayName = actionInfo.displayName;
+        RemoteAction action;
+        action.setName(actionInfo.name);
+        if (action.hintNames.isEmpty()) {
+            continue;
+        }
 
-        const QString hintName = QString(HINT_REMOTE_ACTION_PREFIX) + actionName;
-        const QString &hint = hints[hintName].toString();
+        const QString hint = hints.value(action.hintNames.at(RemoteAction::CallHint)).toString();
         if (!hint.isEmpty()) {
-            QVariantMap action;
 
             // Extract the element of the DBus call
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
@@ -259,12 +453,11 @@ QVariantList decodeActionHints(const QList<NotificationData::ActionInfo> &action
                 qWarning() << "Unable to decode invalid remote action:" << hint;
             } else {
                 int index = 0;
-                action.insert(QStringLiteral("service"), elements.at(index++));
-                action.insert(QStringLiteral("path"), elements.at(index++));
-                action.insert(QStringLiteral("iface"), elements.at(index++));
-                action.insert(QStringLiteral("method"), elements.at(index++));
+                action.service = elements.at(index++);
+                action.path = elements.at(index++);
+                action.iface = elements.at(index++);
+                action.method = elements.at(index++);
 
-                QVariantList args;
                 while (index < elements.size()) {
                     const QString &arg(elements.at(index++));
                     const QByteArray buffer(QByteArray::fromBase64(arg.toUtf8()));
@@ -272,22 +465,21 @@ QVariantList decodeActionHints(const QList<NotificationData::ActionInfo> &action
                     QDataStream stream(buffer);
                     QVariant var;
                     stream >> var;
-                    args.append(var);
+                    action.arguments.append(var);
                 }
-                action.insert(QStringLiteral("arguments"), args);
             }
-            action.insert(QStringLiteral("name"), actionName);
-            action.insert(QStringLiteral("displayName"), displayName);
+            action.displayName = actionInfo.displayName;
+            action.icon = hints.value(action.hintNames.at(RemoteAction::IconHint)).toString();
 
-            const QString iconHintName = QString(HINT_REMOTE_ACTION_ICON_PREFIX) + actionName;
-            const QString &iconHint = hints[iconHintName].toString();
-            if (!iconHint.isEmpty()) {
-                action.insert(QStringLiteral("icon"), iconHint);
+            QVariantHash::const_iterator it = hints.constFind(action.hintNames.at(RemoteAction::InputHint));
+            if (it != hints.constEnd()) {
+                action.setInput(it.value().toMap());
             }
-
-            const QString actionInputHintName = QString(HINT_REMOTE_ACTION_INPUT_PREFIX) + actionName;
-            if (hints.contains(actionInputHintName)) {
-                action.insert(QStringLiteral("input"), hints[actionInputHintName].toMap());
+            for (const QString &hintName : action.hintNames) {
+                it = hints.constFind(hintName);
+                if (it != hints.constEnd()) {
+                    action.encodedHints.insert(hintName, it.value());
+                }
             }
             rv.append(action);
         }
@@ -298,42 +490,258 @@ QVariantList decodeActionHints(const QList<NotificationData::ActionInfo> &action
 
 }
 
+class NotificationDataPrivate : public QSharedData
+{
+public:
+    QString appName;
+    quint32 replacesId = 0;
+    QString appIcon;
+    QString summary;
+    QString body;
+    QList<NotificationData::ActionInfo> actions;
+    QVariantHash hints;
+    qint32 expireTimeout = -1;
+    QString inputText;
+};
+
+namespace {
+
+const QSharedDataPointer<NotificationDataPrivate> &emptyData()
+{
+    // Default-constructed instances share one empty buffer until they are modified
+    static const QSharedDataPointer<NotificationDataPrivate> data(new NotificationDataPrivate);
+    return data;
+}
+
+}
+
+NotificationData::NotificationData()
+    : d(emptyData())
+{
+}
+
+NotificationData::NotificationData(const NotificationData &other)
+    : d(other.d)
+{
+}
+
+NotificationData::~NotificationData()
+{
+}
+
+NotificationData &NotificationData::operator=(const NotificationData &other)
+{
+    d = other.d;
+    return *this;
+}
+
+QString NotificationData::appName() const
+{
+    return d->appName;
+}
+
+void NotificationData::setAppName(const QString &appName)
+{
+    d->appName = appName;
+}
+
+quint32 NotificationData::replacesId() const
+{
+    return d->replacesId;
+}
+
+void NotificationData::setReplacesId(quint32 id)
+{
+    d->replacesId = id;
+}
+
+QString NotificationData::appIcon() const
+{
+    return d->appIcon;
+}
+
+void NotificationData::setAppIcon(const QString &appIcon)
+{
+    d->appIcon = appIcon;
+}
+
+QString NotificationData::summary() const
+{
+    return d->summary;
+}
+
+void NotificationData::setSummary(const QString &summary)
+{
+    d->summary = summary;
+}
+
+QString NotificationData::body() const
+{
+    return d->body;
+}
+
+void NotificationData::setBody(const QString &body)
+{
+    d->body = body;
+}
+
+const QList<NotificationData::ActionInfo> &NotificationData::actions() const
+{
+    return d->actions;
+}
+
+void NotificationData::setActions(const QList<ActionInfo> &actions)
+{
+    d->actions = actions;
+}
+
+const QVariantHash &NotificationData::hints() const
+{
+    return d->hints;
+}
+
+void NotificationData::setHints(const QVariantHash &hints)
+{
+    d->hints = hints;
+}
+
+void NotificationData::setHint(const QString &hint, const QVariant &value)
+{
+    d->hints.insert(hint, value);
+}
+
+void NotificationData::removeHint(const QString &hint)
+{
+    // Avoid detaching when there is nothing to remove
+    if (d->hints.contains(hint)) {
+        d->hints.remove(hint);
+    }
+}
+
+qint32 NotificationData::expireTimeout() const
+{
+    return d->expireTimeout;
+}
+
+void NotificationData::setExpireTimeout(qint32 milliseconds)
+{
+    d->expireTimeout = milliseconds;
+}
+
+QString NotificationData::inputText() const
+{
+    return d->inputText;
+}
+
+void NotificationData::setInputText(const QString &inputText)
+{
+    d->inputText = inputText;
+}
+
 class NotificationPrivate : public NotificationData
 {
     friend class Notification;
 
     NotificationPrivate()
-        : NotificationData()
+        : NotificationData(defaultData())
+        , remoteActionsDecoded(true)
     {
     }
 
     NotificationPrivate(const NotificationData &data)
         : NotificationData(data)
-        , remoteActions(decodeActionHints(actions, hints))
     {
+        setAppName(intern(appName()));
+        setAppIcon(intern(appIcon()));
     }
 
-    QVariantMap firstRemoteAction() const
+    NotificationManagerProxy *notificationManager() const
     {
-        QVariantMap vm;
-        const QVariant firstAction(remoteActions.value(0));
-        if (!firstAction.isNull()) {
-            vm = firstAction.value<QVariantMap>();
+        return connectionManager->notificationManager();
+    }
+
+    void setConnectionManager(NotificationConnectionManager *manager, Notification *q)
+    {
+        // Signals are only received from the notification server on our own connection.
+        // The manager delivers them to us by ID, so we do not need connections of our own
+        if (connectionManager && replacesId() != 0) {
+            connectionManager->notificationIdChanged(q, replacesId(), 0);
         }
-        return vm;
+        // The proxy is not created until it is needed, so unpublished notifications cost no bus activity
+        connectionManager = manager;
+        if (replacesId() != 0) {
+            connectionManager->notificationIdChanged(q, 0, replacesId());
+        }
+    }
+
+    // Listed notifications decode their remote actions from the hints when they are first needed
+    const QList<RemoteAction> &remoteActionList() const
+    {
+        if (!remoteActionsDecoded) {
+            setRemoteActionList(decodeActionHints(actions(), hints()));
+        }
+        return remoteActions;
+    }
+
+    void setRemoteActionList(const QList<RemoteAction> &list) const
+    {
+        remoteActions = list;
+        remoteActionsDecoded = true;
+        remoteActionIndex.clear();
+        for (int i = 0; i < remoteActions.count(); ++i) {
+            const QString &name(remoteActions.at(i).name);
+            // The first action with a given name takes precedence
+            if (!name.isEmpty() && !remoteActionIndex.contains(name)) {
+                remoteActionIndex.insert(name, i);
+            }
+        }
+        remoteActionsVariant.clear();
+        remoteActionsVariantValid = false;
+    }
+
+    const RemoteAction *remoteAction(const QString &name) const
+    {
+        remoteActionList();
+        QHash<QString, int>::const_iterator it = remoteActionIndex.constFind(name);
+        return it != remoteActionIndex.constEnd() ? &remoteActions.at(it.value()) : nullptr;
+    }
+
+    // The remoteActions property, built only for clients that read it
+    const QVariantList &remoteActionVariants() const
+    {
+        if (!remoteActionsVariantValid) {
+            for (const RemoteAction &action : remoteActionList()) {
+                remoteActionsVariant.append(action.toVariant());
+            }
+            remoteActionsVariantValid = true;
+        }
+        return remoteActionsVariant;
+    }
+
+    QVariantMap firstRemoteAction() const
+    {
+        const QList<RemoteAction> &list(remoteActionList());
+        return list.isEmpty() ? QVariantMap() : list.first().toVariant().toMap();
     }
 
     void setFirstRemoteAction(const QVariantMap &vm_, Notification *q)
     {
         QVariantMap vm(vm_);
-        QString name(vm["name"].value<QString>());
+        QString name(vm.value(QStringLiteral("name")).toString());
         if (name.isEmpty()) {
-            vm.insert("name", QString::fromLatin1(DEFAULT_ACTION_NAME));
+            vm.insert(QStringLiteral("name"), DEFAULT_ACTION_NAME);
         }
         q->setRemoteActions(QVariantList() << vm);
     }
 
-    QVariantList remoteActions;
+    mutable QList<RemoteAction> remoteActions;
+    mutable QHash<QString, int> remoteActionIndex;
+    mutable bool remoteActionsDecoded = false;
+    mutable QVariantList remoteActionsVariant;
+    mutable bool remoteActionsVariantValid = false;
+    // The group whose summary this notification was last bundled into
+    QString groupMembership;
+    NotificationConnectionManager *connectionManager = nullptr;
 };
 
 /*!
@@ -490,23 +898,18 @@ Notification::Notification(QObject *parent) :
     QObject(parent),
     d_ptr(new NotificationPrivate)
 {
-    d_ptr->hints.insert(HINT_URGENCY, static_cast<int>(Notification::Normal));
-    connect(notificationManager(), SIGNAL(ActionInvoked(uint,QString)), this, SLOT(checkActionInvoked(uint,QString)));
-    connect(notificationManager(), SIGNAL(NotificationClosed(uint,uint)), this, SLOT(checkNotificationClosed(uint,uint)));
-    connect(notificationManager(), SIGNAL(InputTextSet(uint,QString)), this, SLOT(checkInputTextSet(uint,QString)));
+    d_ptr->setConnectionManager(connMgr(), this);
 }
 
 /*!
-    \fn Notification::Notification(const NotificationData &, QObject *)
+    \fn Notification::Notification(const NotificationData &, NotificationConnectionManager *, QObject *)
     \internal
  */
-Notification::Notification(const NotificationData &data, QObject *parent) :
+Notification::Notification(const NotificationData &data, NotificationConnectionManager *connectionManager, QObject *parent) :
     QObject(parent),
     d_ptr(new NotificationPrivate(data))
 {
-    connect(notificationManager(), SIGNAL(ActionInvoked(uint,QString)), this, SLOT(checkActionInvoked(uint,QString)));
-    connect(notificationManager(), SIGNAL(NotificationClosed(uint,uint)), this, SLOT(checkNotificationClosed(uint,uint)));
-    connect(notificationManager(), SIGNAL(InputTextSet(uint,QString)), this, SLOT(checkInputTextSet(uint,QString)));
+    d_ptr->setConnectionManager(connectionManager, this);
 }
 
 /*!
@@ -515,9 +918,44 @@ Notification::Notification(const NotificationData &data, QObject *parent) :
  */
 Notification::~Notification()
 {
+    if (!d_ptr->groupMembership.isEmpty()) {
+        d_ptr->connectionManager->removeGroupMember(d_ptr->groupMembership, this, false);
+    }
+    if (d_ptr->replacesId() != 0) {
+        d_ptr->connectionManager->notificationIdChanged(this, d_ptr->replacesId(), 0);
+    }
     delete d_ptr;
 }
 
+/*!
+    \fn Notification::setDBusConnection(const QDBusConnection &)
+
+    Binds this notification to the notification server reached over \a bus, rather
+    than the default connection. Each connection has its own proxy and delivers
+    signals only to the notifications bound to it, so a process can drive several
+    notification servers concurrently.
+
+    If the notification has already been published on another connection, its
+    \l replacesId is reset, since that ID is not meaningful to the new server.
+
+    Returns false if \a bus is not connected.
+ */
+bool Notification::setDBusConnection(const QDBusConnection &bus)
+{
+    Q_D(Notification);
+    if (!bus.isConnected()) {
+        qWarning() << "Supplied DBus connection is not connected.";
+        return false;
+    }
+
+    NotificationConnectionManager *manager = NotificationConnectionManager::instance(bus);
+    if (manager != d->connectionManager) {
+        d->setConnectionManager(manager, this);
+        setReplacesId(0);
+    }
+    return true;
+}
+
 /*!
     \qmlproperty string Notification::category
 
@@ -541,14 +979,14 @@ Notification::~Notification()
 QString Notification::category() const
 {
     Q_D(const Notification);
-    return d->hints.value(HINT_CATEGORY).toString();
+    return d->hints().value(HINT_CATEGORY).toString();
 }
 
 void Notification::setCategory(const QString &category)
 {
     Q_D(Notification);
     if (category != this->category()) {
-        d->hints.insert(HINT_CATEGORY, category);
+        d->setHint(HINT_CATEGORY, category);
         emit categoryChanged();
     }
 }
@@ -574,14 +1012,14 @@ void Notification::setCategory(const QString &category)
 QString Notification::appName() const
 {
     Q_D(const Notification);
-    return d->appName;
+    return d->appName();
 }
 
 void Notification::setAppName(const QString &appName)
 {
     Q_D(Notification);
     if (appName != this->appName()) {
-        d->appName = appName;
+        d->setAppName(intern(appName));
         emit appNameChanged();
     }
 }
@@ -611,14 +1049,14 @@ void Notification::setAppName(const QString &appName)
 QString Notification::icon() const
 {
     Q_D(const Notification);
-    return d->hints.value(HINT_IMAGE_PATH).toString();
+    return d->hints().value(HINT_IMAGE_PATH).toString();
 }
 
 void Notification::setIcon(const QString &icon)
 {
     Q_D(Notification);
     if (icon != this->icon()) {
-        d->hints.insert(HINT_IMAGE_PATH, icon);
+        d->setHint(HINT_IMAGE_PATH, icon);
         emit iconChanged();
     }
 }
@@ -650,14 +1088,15 @@ void Notification::setIcon(const QString &icon)
 uint Notification::replacesId() const
 {
     Q_D(const Notification);
-    return d->replacesId;
+    return d->replacesId();
 }
 
 void Notification::setReplacesId(uint id)
 {
     Q_D(Notification);
-    if (d->replacesId != id) {
-        d->replacesId = id;
+    if (d->replacesId() != id) {
+        d->connectionManager->notificationIdChanged(this, d->replacesId(), id);
+        d->setReplacesId(id);
         emit replacesIdChanged();
     }
 }
@@ -681,14 +1120,14 @@ void Notification::setReplacesId(uint id)
 QString Notification::appIcon() const
 {
     Q_D(const Notification);
-    return d->appIcon;
+    return d->appIcon();
 }
 
 void Notification::setAppIcon(const QString &appIcon)
 {
     Q_D(Notification);
     if (appIcon != this->appIcon()) {
-        d->appIcon = appIcon;
+        d->setAppIcon(intern(appIcon));
         emit appIconChanged();
     }
 }
@@ -712,14 +1151,14 @@ void Notification::setAppIcon(const QString &appIcon)
 QString Notification::summary() const
 {
     Q_D(const Notification);
-    return d->summary;
+    return d->summary();
 }
 
 void Notification::setSummary(const QString &summary)
 {
     Q_D(Notification);
-    if (d->summary != summary) {
-        d->summary = summary;
+    if (d->summary() != summary) {
+        d->setSummary(summary);
         emit summaryChanged();
     }
 }
@@ -741,14 +1180,14 @@ void Notification::setSummary(const QString &summary)
 QString Notification::body() const
 {
     Q_D(const Notification);
-    return d->body;
+    return d->body();
 }
 
 void Notification::setBody(const QString &body)
 {
     Q_D(Notification);
-    if (d->body != body) {
-        d->body = body;
+    if (d->body() != body) {
+        d->setBody(body);
         emit bodyChanged();
     }
 }
@@ -791,14 +1230,14 @@ Notification::Urgency Notification::urgency() const
 {
     Q_D(const Notification);
     // Clipping to bounds in case an invalid value is stored as a hint
-    return static_cast<Urgency>(qMax(static_cast<int>(Low), qMin(static_cast<int>(Critical), d->hints.value(HINT_URGENCY).toInt())));
+    return static_cast<Urgency>(qMax(static_cast<int>(Low), qMin(static_cast<int>(Critical), d->hints().value(HINT_URGENCY).toInt())));
 }
 
 void Notification::setUrgency(Urgency urgency)
 {
     Q_D(Notification);
     if (urgency != this->urgency()) {
-        d->hints.insert(HINT_URGENCY, static_cast<int>(urgency));
+        d->setHint(HINT_URGENCY, static_cast<int>(urgency));
         emit urgencyChanged();
     }
 }
@@ -828,14 +1267,14 @@ void Notification::setUrgency(Urgency urgency)
 qint32 Notification::expireTimeout() const
 {
     Q_D(const Notification);
-    return d->expireTimeout;
+    return d->expireTimeout();
 }
 
 void Notification::setExpireTimeout(qint32 milliseconds)
 {
     Q_D(Notification);
-    if (milliseconds != d->expireTimeout) {
-        d->expireTimeout = milliseconds;
+    if (milliseconds != d->expireTimeout()) {
+        d->setExpireTimeout(milliseconds);
         emit expireTimeoutChanged();
     }
 }
@@ -861,14 +1300,14 @@ void Notification::setExpireTimeout(qint32 milliseconds)
 QDateTime Notification::timestamp() const
 {
     Q_D(const Notification);
-    return d->hints.value(HINT_TIMESTAMP).toDateTime();
+    return d->hints().value(HINT_TIMESTAMP).toDateTime();
 }
 
 void Notification::setTimestamp(const QDateTime &timestamp)
 {
     Q_D(Notification);
     if (timestamp != this->timestamp()) {
-        d->hints.insert(HINT_TIMESTAMP, timestamp.toString(Qt::ISODate));
+        d->setHint(HINT_TIMESTAMP, timestamp.toString(Qt::ISODate));
         emit timestampChanged();
     }
 }
@@ -904,14 +1343,14 @@ void Notification::setTimestamp(const QDateTime &timestamp)
 QString Notification::previewSummary() const
 {
     Q_D(const Notification);
-    return d->hints.value(HINT_PREVIEW_SUMMARY).toString();
+    return d->hints().value(HINT_PREVIEW_SUMMARY).toString();
 }
 
 void Notification::setPreviewSummary(const QString &previewSummary)
 {
     Q_D(Notification);
     if (previewSummary != this->previewSummary()) {
-        d->hints.insert(HINT_PREVIEW_SUMMARY, previewSummary);
+        d->setHint(HINT_PREVIEW_SUMMARY, previewSummary);
         emit previewSummaryChanged();
     }
 }
@@ -947,14 +1386,14 @@ void Notification::setPreviewSummary(const QString &previewSummary)
 QString Notification::previewBody() const
 {
     Q_D(const Notification);
-    return d->hints.value(HINT_PREVIEW_BODY).toString();
+    return d->hints().value(HINT_PREVIEW_BODY).toString();
 }
 
 void Notification::setPreviewBody(const QString &previewBody)
 {
     Q_D(Notification);
     if (previewBody != this->previewBody()) {
-        d->hints.insert(HINT_PREVIEW_BODY, previewBody);
+        d->setHint(HINT_PREVIEW_BODY, previewBody);
         emit previewBodyChanged();
     }
 }
@@ -982,14 +1421,14 @@ void Notification::setPreviewBody(const QString &previewBody)
 QString Notification::subText() const
 {
     Q_D(const Notification);
-    return d->hints.value(HINT_SUB_TEXT).toString();
+    return d->hints().value(HINT_SUB_TEXT).toString();
 }
 
 void Notification::setSubText(const QString &subText)
 {
     Q_D(Notification);
     if (subText != this->subText()) {
-        d->hints.insert(HINT_SUB_TEXT, subText);
+        d->setHint(HINT_SUB_TEXT, subText);
         emit subTextChanged();
     }
 }
@@ -1011,14 +1450,14 @@ void Notification::setSubText(const QString &subText)
 QString Notification::sound() const
 {
     Q_D(const Notification);
-    return d->hints.value(HINT_SOUND_FILE).toString();
+    return d->hints().value(HINT_SOUND_FILE).toString();
 }
 
 void Notification::setSound(const QString &sound)
 {
     Q_D(Notification);
     if (sound != this->sound()) {
-        d->hints.insert(HINT_SOUND_FILE, sound);
+        d->setHint(HINT_SOUND_FILE, sound);
         emit soundChanged();
     }
 }
@@ -1044,14 +1483,14 @@ void Notification::setSound(const QString &sound)
 QString Notification::soundName() const
 {
     Q_D(const Notification);
-    return d->hints.value(HINT_SOUND_NAME).toString();
+    return d->hints().value(HINT_SOUND_NAME).toString();
 }
 
 void Notification::setSoundName(const QString &soundName)
 {
     Q_D(Notification);
     if (soundName != this->soundName()) {
-        d->hints.insert(HINT_SOUND_NAME, soundName);
+        d->setHint(HINT_SOUND_NAME, soundName);
         emit soundNameChanged();
     }
 }
@@ -1082,14 +1521,14 @@ void Notification::setSoundName(const QString &soundName)
 QImage Notification::iconData() const
 {
     Q_D(const Notification);
-    return d->hints.value(HINT_IMAGE_DATA).value<NotificationImage>();
+    return d->hints().value(HINT_IMAGE_DATA).value<NotificationImage>();
 }
 
 void Notification::setIconData(const QImage &image)
 {
     Q_D(Notification);
     if (image != this->iconData()) {
-        d->hints.insert(HINT_IMAGE_DATA, QVariant::fromValue(NotificationImage(image)));
+        d->setHint(HINT_IMAGE_DATA, QVariant::fromValue(NotificationImage(image)));
         emit iconDataChanged();
     }
 }
@@ -1113,14 +1552,14 @@ void Notification::setIconData(const QImage &image)
 int Notification::itemCount() const
 {
     Q_D(const Notification);
-    return d->hints.value(HINT_ITEM_COUNT).toInt();
+    return d->hints().value(HINT_ITEM_COUNT).toInt();
 }
 
 void Notification::setItemCount(int itemCount)
 {
     Q_D(Notification);
     if (itemCount != this->itemCount()) {
-        d->hints.insert(HINT_ITEM_COUNT, itemCount);
+        d->setHint(HINT_ITEM_COUNT, itemCount);
         emit itemCountChanged();
     }
 }
@@ -1144,33 +1583,38 @@ void Notification::setItemCount(int itemCount)
     new details.
  */
 void Notification::publish()
+{
+    publish(0);
+}
+
+/*!
+    \fn Notification::publish(NotificationQueue *)
+    \internal
+
+    Returns true if the notification was scheduled for publication on behalf of \a queue,
+    which is then informed when it has been published.
+ */
+bool Notification::publish(NotificationQueue *queue)
 {
     Q_D(Notification);
 
     // Validate the actions associated with the notification
-    Q_FOREACH (const QVariant &action, d->remoteActions) {
-        const QVariantMap &vm = action.value<QVariantMap>();
-        int callbackParameters = 0;
-        if (!vm["service"].value<QString>().isEmpty()) callbackParameters++;
-        if (!vm["path"].value<QString>().isEmpty()) callbackParameters++;
-        if (!vm["iface"].value<QString>().isEmpty()) callbackParameters++;
-        if (!vm["method"].value<QString>().isEmpty()) callbackParameters++;
-
-        if (vm["name"].value<QString>().isEmpty()
+    for (const RemoteAction &action : d->remoteActionList()) {
+        const int callbackParameters = action.callbackParameters();
+        if (action.name.isEmpty()
                 || (callbackParameters != 0 && callbackParameters != 4)) {
-            qWarning() << "Invalid remote action specification:" << action;
+            qWarning() << "Invalid remote action specification:" << action.toVariantMap();
         }
     }
 
     // Ensure the ownership of this notification is recorded
-    QVariantHash::iterator it = d->hints.find(HINT_OWNER);
-    if (it == d->hints.end()) {
-        d->hints.insert(HINT_OWNER, processName());
+    if (!d->hints().contains(HINT_OWNER)) {
+        d->setHint(HINT_OWNER, processName());
     }
 
     // Use the summary and body as fallback values for previewSummary and previewBody, unless the
     // preview values have explicitly been reset to invalid variants.
-    QVariantHash hints = d->hints;
+    QVariantHash hints = d->hints();
     auto setDefaultPreview = [&hints](const QString &hint, const QString &defaultValue) -> void {
         auto it = hints.find(hint);
         if (it == hints.end()) {
@@ -1178,11 +1622,88 @@ void Notification::publish()
         }
     };
 
-    setDefaultPreview(HINT_PREVIEW_SUMMARY, d->summary);
-    setDefaultPreview(HINT_PREVIEW_BODY, d->body);
+    setDefaultPreview(HINT_PREVIEW_SUMMARY, d->summary());
+    setDefaultPreview(HINT_PREVIEW_BODY, d->body());
+
+    // Grouped notifications update their group's summary notification
+    const QString groupId(hints.value(HINT_GROUP_ID).toString());
+    if (d->groupMembership != groupId) {
+        if (!d->groupMembership.isEmpty()) {
+            d->connectionManager->removeGroupMember(d->groupMembership, this, true);
+        }
+        d->groupMembership = groupId;
+    }
+    if (!groupId.isEmpty()) {
+        NotificationData data(*d);
+        data.setHints(hints);
+        if (d->connectionManager->bundleGrouped(groupId, &data, this)) {
+            return false;
+        }
+        setReplacesId(data.replacesId());
+        hints = data.hints();
+    }
+
+    // Publications that would not change an existing notification need not be sent. The digest
+    // is also taken for new notifications, so that their first update can be compared with it
+    QByteArray digest;
+    if (d->connectionManager->duplicatePolicy() != NotificationConnectionManager::PublishDuplicates) {
+        NotificationData data(*d);
+        data.setHints(hints);
+        if (d->connectionManager->filterDuplicate(&data, &digest)) {
+            if (!groupId.isEmpty()) {
+                // The summary is unchanged
+                d->connectionManager->groupPublished(groupId, d->replacesId());
+            }
+            return false;
+        }
+        hints = data.hints();
+    }
+
+    if (queue || d->connectionManager->asynchronousPublishing()) {
+        // replacesId is updated when the notification server has replied
+        NotificationData data(*d);
+        data.setHints(hints);
+        d->connectionManager->schedulePublish(data, this, digest, queue);
+        return queue != 0;
+    }
+
+    QElapsedTimer sent;
+    sent.start();
+    QDBusPendingReply<uint> reply = d->notificationManager()->Notify(appName(), d->replacesId(), appIcon(), d->summary(), d->body(),
+                                                                     encodeActions(d->actions()), hints, d->expireTimeout());
+    reply.waitForFinished();
+    d->connectionManager->publishCompleted(sent.nsecsElapsed() / 1000, !reply.isError());
+    if (reply.isError() && isServiceUnavailable(reply.error())) {
+        // Publish when the notification service appears, if the queue is enabled
+        NotificationData data(*d);
+        data.setHints(hints);
+        if (d->connectionManager->enqueueOffline(data, this)) {
+            if (!groupId.isEmpty()) {
+                d->connectionManager->groupPublished(groupId, 0);
+            }
+            return false;
+        }
+    }
+
+    const uint previousId = d->replacesId();
+    setReplacesId(reply.value());
+
+    // The digest is recorded under the ID the server returned, which is new for a new notification
+    if (!digest.isEmpty() && reply.value() != 0) {
+        d->connectionManager->publishAcknowledged(reply.value(), digest, hints);
+    }
+
+    if (!groupId.isEmpty()) {
+        d->connectionManager->groupPublished(groupId, d->replacesId());
+    }
+
+    if (d->replacesId() != 0 && d->connectionManager->listingCacheEnabled()) {
+        NotificationData data(*d);
+        data.setHints(hints);
+        d->connectionManager->notificationPublished(previousId, data);
+    }
 
-    setReplacesId(notificationManager()->Notify(appName(), d->replacesId, appIcon(), d->summary, d->body,
-                                                encodeActions(d->actions), hints, d->expireTimeout));
+    return false;
 }
 
 
@@ -1199,8 +1720,15 @@ void Notification::publish()
 void Notification::close()
 {
     Q_D(Notification);
-    if (d->replacesId != 0) {
-        notificationManager()->CloseNotification(d->replacesId);
+    d->connectionManager->cancelOffline(this);
+    d->connectionManager->cancelScheduledPublish(this);
+    if (!d->groupMembership.isEmpty()) {
+        d->connectionManager->removeGroupMember(d->groupMembership, this, true);
+        d->groupMembership.clear();
+    }
+    if (d->replacesId() != 0) {
+        d->notificationManager()->CloseNotification(d->replacesId());
+        d->connectionManager->notificationRemoved(d->replacesId());
         setReplacesId(0);
     }
 }
@@ -1274,24 +1802,16 @@ void Notification::close()
 void Notification::checkActionInvoked(uint id, QString actionKey)
 {
     Q_D(Notification);
-    if (id == d->replacesId) {
-        foreach (const QVariant &action, d->remoteActions) {
-            QVariantMap vm = action.value<QVariantMap>();
-            const QString actionName = vm["name"].value<QString>();
-            if (!actionName.isEmpty() && actionName == actionKey) {
-                if (vm.contains("input")) { // Need input
-                    const QVariantMap input = vm["input"].value<QVariantMap>();
-                    if (d->inputText.isEmpty() // Input is empty
-                        || (input.contains("choices") && !input["choices"].value<QStringList>().contains(d->inputText) // and not a valid choice 
-                            && (!input.contains("editable") || input["editable"].toBool() == false))) { // and not editable
-                        // TODO: Some sort of signal of rejection to the sender?
-                        break;
-                    }
-                    emit inputActionInvoked(actionKey, d->inputText);
+    if (id == d->replacesId()) {
+        if (const RemoteAction *action = d->remoteAction(actionKey)) {
+            if (action->hasInput) { // Need input
+                if (!action->acceptsInput(d->inputText())) { // Empty, or not a valid choice and not editable
+                    // TODO: Some sort of signal of rejection to the sender?
                 } else {
-                    emit actionInvoked(actionKey);
+                    emit inputActionInvoked(actionKey, d->inputText());
                 }
-                break;
+            } else {
+                emit actionInvoked(actionKey);
             }
         }
         if (actionKey == DEFAULT_ACTION_NAME) {
@@ -1303,8 +1823,8 @@ void Notification::checkActionInvoked(uint id, QString actionKey)
 void Notification::checkInputTextSet(uint id, const QString &inputText)
 {
     Q_D(Notification);
-    if (id == d->replacesId && inputText != d->inputText) {
-        d->inputText = inputText;
+    if (id == d->replacesId() && inputText != d->inputText()) {
+        d->setInputText(inputText);
     }
 }
 
@@ -1329,7 +1849,7 @@ void Notification::checkInputTextSet(uint id, const QString &inputText)
 void Notification::checkNotificationClosed(uint id, uint reason)
 {
     Q_D(Notification);
-    if (id == d->replacesId) {
+    if (id == d->replacesId()) {
         emit closed(reason);
         setReplacesId(0);
     }
@@ -1568,45 +2088,75 @@ void Notification::setRemoteDBusCallArguments(const QVariantList &arguments)
 QVariantList Notification::remoteActions() const
 {
     Q_D(const Notification);
-    return d->remoteActions;
+    return d->remoteActionVariants();
 }
 
 void Notification::setRemoteActions(const QVariantList &remoteActions)
 {
     Q_D(Notification);
-    if (remoteActions != d->remoteActions) {
-        // Remove any existing actions
-        foreach (const QVariant &action, d->remoteActions) {
-            QVariantMap vm = action.value<QVariantMap>();
-            const QString actionName = vm["name"].value<QString>();
-            if (!actionName.isEmpty()) {
-                d->hints.remove(QString(HINT_REMOTE_ACTION_PREFIX) + actionName);
-                for (int i = 0; i < d->actions.count(); ++i) {
-                    if (d->actions.at(i).name == actionName) {
-                        d->actions.removeAt(i);
-                        break;
-                    }
-                }
-            }
-        }
 
-        // Add the new actions and their associated hints
-        d->remoteActions = remoteActions;
+    if (remoteActions == d->remoteActionVariants()) {
+        return;
+    }
 
-        QPair<QList<NotificationData::ActionInfo>, QVariantHash> actionHints = encodeActionHints(remoteActions);
+    // Only actions that are new or have changed need to be encoded; the others keep their hints
+    QVariantHash newHints;
+    QList<NotificationData::ActionInfo> newActions;
+    QList<RemoteAction> actionList;
+    for (const QVariant &specification : remoteActions) {
+        RemoteAction action(RemoteAction::fromVariant(specification));
+        if (!action.name.isEmpty()) {
+            const NotificationData::ActionInfo actionInfo = { action.name, action.displayName };
+            newActions.append(actionInfo);
+
+            const RemoteAction *existing = d->remoteAction(action.name);
+            if (existing && *existing == action) {
+                action.encodedHints = existing->encodedHints;
+            } else {
+                action.encodedHints = encodeActionHints(action);
+            }
+            for (QVariantHash::const_iterator it = action.encodedHints.constBegin(); it != action.encodedHints.constEnd(); ++it) {
+                newHints.insert(it.key(), it.value());
+            }
+        }
+        actionList.append(action);
+    }
 
-        for (const NotificationData::ActionInfo &actionInfo : actionHints.first) {
-            d->actions.append(actionInfo);
+    // Remove the hints of replaced actions
+    QSet<QString> oldActionNames;
+    for (const RemoteAction &action : d->remoteActionList()) {
+        if (action.name.isEmpty()) {
+            continue;
+        }
+        oldActionNames.insert(action.name);
+        for (const QString &hintName : action.hintNames) {
+            if (!newHints.contains(hintName)) {
+                d->removeHint(hintName);
+            }
         }
+    }
 
-        QVariantHash::const_iterator hit = actionHints.second.constBegin(), hend = actionHints.second.constEnd();
-        for ( ; hit != hend; ++hit) {
-            d->hints.insert(hit.key(), hit.value());
+    for (QVariantHash::const_iterator it = newHints.constBegin(); it != newHints.constEnd(); ++it) {
+        QVariantHash::const_iterator existing = d->hints().constFind(it.key());
+        if (existing == d->hints().constEnd() || existing.value() != it.value()) {
+            d->setHint(it.key(), it.value());
         }
+    }
 
-        emit remoteActionsChanged();
-        emit remoteDBusCallChanged();
+    // Actions that are not remote actions are preserved, followed by the new remote actions
+    QList<NotificationData::ActionInfo> actions;
+    for (const NotificationData::ActionInfo &actionInfo : d->actions()) {
+        if (!oldActionNames.contains(actionInfo.name)) {
+            actions.append(actionInfo);
+        }
     }
+    actions.append(newActions);
+    d->setActions(actions);
+
+    d->setRemoteActionList(actionList);
+
+    emit remoteActionsChanged();
+    emit remoteDBusCallChanged();
 }
 
 /*!
@@ -1645,7 +2195,7 @@ void Notification::setRemoteActions(const QVariantList &remoteActions)
 QString Notification::origin() const
 {
     Q_D(const Notification);
-    return d->hints.value(HINT_ORIGIN).toString();
+    return d->hints().value(HINT_ORIGIN).toString();
 }
 
 void Notification::setOrigin(const QString &origin)
@@ -1653,7 +2203,7 @@ void Notification::setOrigin(const QString &origin)
     Q_D(Notification);
     if (origin != this->origin()) {
         qWarning() << "Notification sets deprecated origin property to" << origin << ", use subText instead";
-        d->hints.insert(HINT_ORIGIN, origin);
+        d->setHint(HINT_ORIGIN, origin);
         emit originChanged();
     }
 }
@@ -1679,7 +2229,7 @@ void Notification::setOrigin(const QString &origin)
 int Notification::maxContentLines() const
 {
     Q_D(const Notification);
-    return d->hints.value(HINT_MAX_CONTENT_LINES).toInt();
+    return d->hints().value(HINT_MAX_CONTENT_LINES).toInt();
 }
 
 void Notification::setMaxContentLines(int max)
@@ -1687,7 +2237,7 @@ void Notification::setMaxContentLines(int max)
     Q_D(Notification);
     if (max != this->maxContentLines()) {
         qWarning() << "Notification::maxContentLines property is deprecated";
-        d->hints.insert(HINT_MAX_CONTENT_LINES, max);
+        d->setHint(HINT_MAX_CONTENT_LINES, max);
         emit maxContentLinesChanged();
     }
 }
@@ -1710,14 +2260,14 @@ void Notification::setMaxContentLines(int max)
 bool Notification::isTransient() const
 {
     Q_D(const Notification);
-    return d->hints.value(HINT_TRANSIENT).toBool();
+    return d->hints().value(HINT_TRANSIENT).toBool();
 }
 
 void Notification::setIsTransient(bool value)
 {
     Q_D(Notification);
     if (value != this->isTransient()) {
-        d->hints.insert(HINT_TRANSIENT, value);
+        d->setHint(HINT_TRANSIENT, value);
         emit isTransientChanged();
     }
 }
@@ -1739,14 +2289,14 @@ void Notification::setIsTransient(bool value)
 bool Notification::resident() const
 {
     Q_D(const Notification);
-    return d->hints.value(HINT_RESIDENT).toBool();
+    return d->hints().value(HINT_RESIDENT).toBool();
 }
 
 void Notification::setResident(bool value)
 {
     Q_D(Notification);
     if (value != this->resident()) {
-        d->hints.insert(HINT_RESIDENT, value);
+        d->setHint(HINT_RESIDENT, value);
         emit residentChanged();
     }
 }
@@ -1767,7 +2317,7 @@ void Notification::setResident(bool value)
 QVariant Notification::progress() const
 {
     Q_D(const Notification);
-    return d->hints.value(HINT_PROGRESS);
+    return d->hints().value(HINT_PROGRESS);
 }
 
 void Notification::setProgress(const QVariant &value)
@@ -1780,7 +2330,7 @@ void Notification::setProgress(const QVariant &value)
         // D-Bus doesn't support float types so force to double to avoid apps getting surprised
         QVariant filteredValue(value.toDouble());
         if (filteredValue != this->progress()) {
-            d->hints.insert(HINT_PROGRESS, filteredValue);
+            d->setHint(HINT_PROGRESS, filteredValue);
             emit progressChanged();
         }
     }
@@ -1789,12 +2339,84 @@ void Notification::setProgress(const QVariant &value)
 void Notification::resetProgress()
 {
     Q_D(Notification);
-    if (d->hints.contains(HINT_PROGRESS)) {
-        d->hints.remove(HINT_PROGRESS);
+    if (d->hints().contains(HINT_PROGRESS)) {
+        d->removeHint(HINT_PROGRESS);
         emit progressChanged();
     }
 }
 
+/*!
+    \qmlmethod void Notification::updateProgress(value)
+
+    Sets \l progress to \a value and updates the published notification with only the new progress.
+
+    Updates are sent at a limited rate, and small changes are not sent until they accumulate, so this
+    may be called for every step of a long operation. A notification which has not been published
+    is published in full.
+*/
+/*!
+    \fn Notification::updateProgress(const QVariant &value)
+
+    Sets \l progress to \a value and updates the published notification with only the new progress.
+
+    Updates are sent at a limited rate, and small changes are not sent until they accumulate, so this
+    may be called for every step of a long operation. A notification which has not been published
+    is published in full.
+ */
+void Notification::updateProgress(const QVariant &value)
+{
+    Q_D(Notification);
+    setProgress(value);
+    if (d->replacesId() == 0) {
+        publish();
+    } else {
+        d->connectionManager->updateProgress(this, d->replacesId(), progress());
+    }
+}
+
+/*!
+    \qmlproperty string Notification::groupId
+
+    Identifies a group of related notifications, such as the messages of one conversation.
+
+    Notifications sharing a group ID are presented as a single summary notification,
+    whose \l itemCount is the total of its members. Members published shortly after
+    the summary was last updated are collapsed into one deferred update, which shows
+    the content of the latest member.
+
+    This property is transmitted as the extension hint value "x-nemo-group-id".
+ */
+/*!
+    \property Notification::groupId
+
+    Identifies a group of related notifications, such as the messages of one conversation.
+
+    Notifications sharing a group ID are presented as a single summary notification,
+    whose \l itemCount is the total of its members. Members published shortly after
+    the summary was last updated are collapsed into one deferred update, which shows
+    the content of the latest member.
+
+    This property is transmitted as the extension hint value "x-nemo-group-id".
+ */
+QString Notification::groupId() const
+{
+    Q_D(const Notification);
+    return d->hints().value(HINT_GROUP_ID).toString();
+}
+
+void Notification::setGroupId(const QString &groupId)
+{
+    Q_D(Notification);
+    if (groupId != this->groupId()) {
+        if (groupId.isEmpty()) {
+            d->removeHint(HINT_GROUP_ID);
+        } else {
+            d->setHint(HINT_GROUP_ID, groupId);
+        }
+        emit groupIdChanged();
+    }
+}
+
 /*!
     \fn Notification::hintValue(const QString &) const
 
@@ -1803,7 +2425,7 @@ void Notification::resetProgress()
 QVariant Notification::hintValue(const QString &hint) const
 {
     Q_D(const Notification);
-    return d->hints.value(hint);
+    return d->hints().value(hint);
 }
 
 /*!
@@ -1819,7 +2441,7 @@ void Notification::setHintValue(const QString &hint, const QVariant &value)
         qWarning() << "Invalid value given for notification hint" << hint;
         return;
     }
-    d->hints.insert(hint, value);
+    d->setHint(hint, value);
 }
 
 /*!
@@ -1853,12 +2475,23 @@ QList<QObject*> Notification::notifications()
  */
 QList<QObject*> Notification::notifications(const QString &owner)
 {
-    QList<NotificationData> notifications = notificationManager()->GetNotifications(owner);
-    QList<QObject*> objects;
-    foreach (const NotificationData &notification, notifications) {
-        objects.append(createNotification(notification, notificationManager()));
-    }
-    return objects;
+    return notifications(connMgr(), owner);
+}
+
+/*!
+    \fn Notification::notifications(const QString &, const QDBusConnection &)
+
+    Returns a list of existing notifications whose 'x-nemo-owner' hint value
+    matches \a owner, as reported by the notification server reached over \a bus.
+
+    The returned objects are bound to \a bus. The caller takes ownership and
+    should destroy them when they are no longer required.
+
+    \sa setDBusConnection()
+ */
+QList<QObject*> Notification::notifications(const QString &owner, const QDBusConnection &bus)
+{
+    return notifications(NotificationConnectionManager::instance(bus), owner);
 }
 
 /*!
@@ -1872,14 +2505,190 @@ QList<QObject*> Notification::notifications(const QString &owner)
  */
 QList<QObject *> Notification::notificationsByCategory(const QString &category)
 {
-    QList<NotificationData> notifications = notificationManager()->GetNotificationsByCategory(category);
+    return notificationsByCategory(connMgr(), category);
+}
+
+/*!
+    \fn Notification::notificationsByCategory(const QString &, const QDBusConnection &)
+
+    Returns a list of existing notifications whose 'category' hint value
+    matches \a category, as reported by the notification server reached over \a bus.
+    This requires privileged access rights from the caller.
+
+    The returned objects are bound to \a bus. The caller takes ownership and
+    should destroy them when they are no longer required.
+
+    \sa setDBusConnection()
+ */
+QList<QObject *> Notification::notificationsByCategory(const QString &category, const QDBusConnection &bus)
+{
+    return notificationsByCategory(NotificationConnectionManager::instance(bus), category);
+}
+
+/*!
+    \fn Notification::notifications(NotificationConnectionManager *, const QString &)
+    \internal
+ */
+QList<QObject*> Notification::notifications(NotificationConnectionManager *connectionManager, const QString &owner)
+{
+    const QList<NotificationData> notifications = connectionManager->notifications(owner);
+    QList<QObject*> objects;
+    foreach (const NotificationData &notification, notifications) {
+        objects.append(createNotification(notification, connectionManager, connectionManager));
+    }
+    return objects;
+}
+
+/*!
+    \fn Notification::notificationsByCategory(NotificationConnectionManager *, const QString &)
+    \internal
+ */
+QList<QObject *> Notification::notificationsByCategory(NotificationConnectionManager *connectionManager, const QString &category)
+{
+    const QList<NotificationData> notifications = connectionManager->notificationsByCategory(category);
     QList<QObject*> objects;
     foreach (const NotificationData &notification, notifications) {
-        objects.append(createNotification(notification, notificationManager()));
+        objects.append(createNotification(notification, connectionManager, connectionManager));
     }
     return objects;
 }
 
+/*!
+    \qmlmethod void Notification::closeAll()
+
+    Closes all existing notifications whose 'x-nemo-owner' hint value matches
+    the process name of the running process.
+*/
+/*!
+    \fn Notification::closeAll()
+
+    Closes all existing notifications whose 'x-nemo-owner' hint value matches
+    the process name of the running process.
+
+    This function does not wait for the notification server to respond.
+ */
+void Notification::closeAll()
+{
+    closeAll(processName());
+}
+
+/*!
+    \qmlmethod void Notification::closeAll(owner)
+
+    Closes all existing notifications whose 'x-nemo-owner' hint value matches \a owner.
+*/
+/*!
+    \fn Notification::closeAll(const QString &)
+
+    Closes all existing notifications whose 'x-nemo-owner' hint value matches \a owner.
+
+    This function does not wait for the notification server to respond.
+ */
+void Notification::closeAll(const QString &owner)
+{
+    connMgr()->closeAll(owner);
+}
+
+/*!
+    \fn Notification::closeAll(const QString &, const QDBusConnection &)
+
+    Closes all existing notifications whose 'x-nemo-owner' hint value matches \a owner,
+    on the notification server reached over \a bus.
+
+    \sa setDBusConnection()
+ */
+void Notification::closeAll(const QString &owner, const QDBusConnection &bus)
+{
+    NotificationConnectionManager::instance(bus)->closeAll(owner);
+}
+
+/*!
+    \qmlmethod void Notification::closeAllByCategory(category)
+
+    Closes all existing notifications whose 'category' hint value matches \a category.
+    This requires privileged access rights from the caller.
+*/
+/*!
+    \fn Notification::closeAllByCategory(const QString &)
+
+    Closes all existing notifications whose 'category' hint value matches \a category.
+    This requires privileged access rights from the caller.
+
+    This function does not wait for the notification server to respond.
+ */
+void Notification::closeAllByCategory(const QString &category)
+{
+    connMgr()->closeAllByCategory(category);
+}
+
+/*!
+    \fn Notification::closeAllByCategory(const QString &, const QDBusConnection &)
+
+    Closes all existing notifications whose 'category' hint value matches \a category,
+    on the notification server reached over \a bus.
+    This requires privileged access rights from the caller.
+
+    \sa setDBusConnection()
+ */
+void Notification::closeAllByCategory(const QString &category, const QDBusConnection &bus)
+{
+    NotificationConnectionManager::instance(bus)->closeAllByCategory(category);
+}
+
+/*!
+    \fn Notification::notificationsAsync(const QString &)
+
+    Returns a future for the list of existing notifications whose 'x-nemo-owner' hint
+    value matches \a owner. Unlike notifications(), this does not block while the
+    notification server responds; the reply is decoded on the global thread pool.
+
+    The result is made available on the calling thread, which must run an event loop.
+    The caller takes ownership of the returned objects.
+ */
+QFuture<QList<QObject*> > Notification::notificationsAsync(const QString &owner)
+{
+    return connMgr()->notificationsAsync(owner);
+}
+
+/*!
+    \fn Notification::notificationsAsync(const QString &, const QDBusConnection &)
+
+    Returns a future for the list of existing notifications whose 'x-nemo-owner' hint
+    value matches \a owner, as reported by the notification server reached over \a bus.
+
+    \sa notificationsAsync()
+ */
+QFuture<QList<QObject*> > Notification::notificationsAsync(const QString &owner, const QDBusConnection &bus)
+{
+    return NotificationConnectionManager::instance(bus)->notificationsAsync(owner);
+}
+
+/*!
+    \fn Notification::notificationsByCategoryAsync(const QString &)
+
+    Returns a future for the list of existing notifications whose 'category' hint
+    value matches \a category. This requires privileged access rights from the caller.
+
+    \sa notificationsAsync()
+ */
+QFuture<QList<QObject*> > Notification::notificationsByCategoryAsync(const QString &category)
+{
+    return connMgr()->notificationsByCategoryAsync(category);
+}
+
+/*!
+    \fn Notification::notificationsByCategoryAsync(const QString &, const QDBusConnection &)
+
+    Returns a future for the list of existing notifications whose 'category' hint
+    value matches \a category, as reported by the notification server reached over \a bus.
+
+    \sa notificationsAsync()
+ */
+QFuture<QList<QObject*> > Notification::notificationsByCategoryAsync(const QString &category, const QDBusConnection &bus)
+{
+    return NotificationConnectionManager::instance(bus)->notificationsByCategoryAsync(category);
+}
+
 /*!
     \fn Notification::remoteAction(const QString &, const QString &, const QString &, const QString &, const QString &, const QString &, const QVariantList &)
 
@@ -1957,62 +2766,2421 @@ QVariant Notification::actionSetInputFormat(QVariant &action, QString &label, bo
 }
 
 /*!
-    \fn Notification::createNotification(const NotificationData &, QObject *)
+    \fn Notification::createNotification(const NotificationData &, NotificationConnectionManager *, QObject *)
     \internal
  */
-Notification *Notification::createNotification(const NotificationData &data, QObject *parent)
+Notification *Notification::createNotification(const NotificationData &data, NotificationConnectionManager *connectionManager, QObject *parent)
 {
-    return new Notification(data, parent);
+    return new Notification(data, connectionManager, parent);
 }
 
 QDBusArgument &operator<<(QDBusArgument &argument, const NotificationData &data)
 {
     argument.beginStructure();
-    argument << data.appName;
-    argument << data.replacesId;
-    argument << data.appIcon;
-    argument << data.summary;
-    argument << data.body;
-    argument << encodeActions(data.actions);
-    argument << data.hints;
-    argument << data.expireTimeout;
+    argument << data.appName();
+    argument << data.replacesId();
+    argument << data.appIcon();
+    argument << data.summary();
+    argument << data.body();
+    argument << encodeActions(data.actions());
+    argument << data.hints();
+    argument << data.expireTimeout();
     argument.endStructure();
     return argument;
 }
 
 const QDBusArgument &operator>>(const QDBusArgument &argument, NotificationData &data)
 {
+    QString appName;
+    quint32 replacesId = 0;
+    QString appIcon;
+    QString summary;
+    QString body;
     QStringList tempStringList;
+    QVariantHash hints;
+    qint32 expireTimeout = -1;
 
     argument.beginStructure();
-    argument >> data.appName;
-    argument >> data.replacesId;
-    argument >> data.appIcon;
-    argument >> data.summary;
-    argument >> data.body;
+    argument >> appName;
+    argument >> replacesId;
+    argument >> appIcon;
+    argument >> summary;
+    argument >> body;
     argument >> tempStringList;
-    argument >> data.hints;
-    argument >> data.expireTimeout;
+    argument >> hints;
+    argument >> expireTimeout;
     argument.endStructure();
 
-    data.actions = decodeActions(tempStringList);
+    data = NotificationData();
+    data.setAppName(appName);
+    data.setReplacesId(replacesId);
+    data.setAppIcon(appIcon);
+    data.setSummary(summary);
+    data.setBody(body);
+    data.setActions(decodeActions(tempStringList));
+    data.setHints(hints);
+    data.setExpireTimeout(expireTimeout);
 
     return argument;
 }
 
-bool NotificationConnectionManager::useDBusConnection(const QDBusConnection &conn)
+namespace {
+
+const char CODEC_MAGIC[] = { 'N', 'D' };
+const quint8 CODEC_VERSION = 1;
+
+enum CodecValueType {
+    CodecInvalid = 0,
+    CodecString,
+    CodecInt,
+    CodecUInt,
+    CodecLongLong,
+    CodecULongLong,
+    CodecBool,
+    CodecDouble,
+    CodecImage,
+    CodecVariant
+};
+
+// Well-known hint keys are encoded as their index in this list; only append to it
+const QStringList &codecHintKeys()
 {
-    if (connMgr()->proxy.isNull()) {
-        if (conn.isConnected()) {
-            connMgr()->dBusConnection.reset(new QDBusConnection(conn));
-            return true;
+    static const QStringList keys = QStringList()
+            << HINT_CATEGORY << HINT_URGENCY << HINT_TRANSIENT << HINT_RESIDENT
+            << HINT_ITEM_COUNT << HINT_TIMESTAMP << HINT_PREVIEW_BODY << HINT_PREVIEW_SUMMARY
+            << HINT_SUB_TEXT << HINT_ORIGIN << HINT_OWNER << HINT_MAX_CONTENT_LINES
+            << HINT_PROGRESS << HINT_SOUND_FILE << HINT_SOUND_NAME << HINT_IMAGE_DATA
+            << HINT_IMAGE_PATH << HINT_GROUP_ID;
+    return keys;
+}
+
+const QHash<QString, int> &codecHintIndices()
+{
+    static const QHash<QString, int> indices = []() {
+        QHash<QString, int> rv;
+        const QStringList &keys(codecHintKeys());
+        for (int i = 0; i < keys.count(); ++i) {
+            rv.insert(keys.at(i), i);
+        }
+        return rv;
+    }();
+    return indices;
+}
+
+class CodecWriter
+{
+public:
+    explicit CodecWriter(QByteArray *buffer)
+        : m_buffer(buffer)
+    {
+    }
+
+    void writeByte(quint8 value)
+    {
+        m_buffer->append(static_cast<char>(value));
+    }
+
+    void writeVarint(quint64 value)
+    {
+        while (value >= 0x80) {
+            writeByte(static_cast<quint8>(value) | 0x80);
+            value >>= 7;
+        }
+        writeByte(static_cast<quint8>(value));
+    }
+
+    void writeSigned(qint64 value)
+    {
+        writeVarint((static_cast<quint64>(value) << 1) ^ static_cast<quint64>(value >> 63));
+    }
+
+    void writeBytes(const char *data, int size)
+    {
+        writeVarint(size);
+        m_buffer->append(data, size);
+    }
+
+    void writeString(const QString &string)
+    {
+        writeVarint(string.size());
+
+        // UTF-16LE content is kept 2-byte aligned so that it can be referenced in place
+        if (m_buffer->size() & 1) {
+            writeByte(0);
+        }
+        const int offset = m_buffer->size();
+        m_buffer->resize(offset + string.size() * 2);
+        char *out = m_buffer->data() + offset;
+        for (const QChar c : string) {
+            *out++ = static_cast<char>(c.unicode() & 0xff);
+            *out++ = static_cast<char>(c.unicode() >> 8);
+        }
+    }
+
+    void writeValue(const QVariant &value)
+    {
+        switch (value.userType()) {
+        case QMetaType::QString:
+            writeByte(CodecString);
+            writeString(value.toString());
+            return;
+        case QMetaType::Int:
+            writeByte(CodecInt);
+            writeSigned(value.toInt());
+            return;
+        case QMetaType::UInt:
+            writeByte(CodecUInt);
+            writeVarint(value.toUInt());
+            return;
+        case QMetaType::LongLong:
+            writeByte(CodecLongLong);
+            writeSigned(value.toLongLong());
+            return;
+        case QMetaType::ULongLong:
+            writeByte(CodecULongLong);
+            writeVarint(value.toULongLong());
+            return;
+        case QMetaType::Bool:
+            writeByte(CodecBool);
+            writeByte(value.toBool() ? 1 : 0);
+            return;
+        case QMetaType::Double: {
+            writeByte(CodecDouble);
+            const double d = value.toDouble();
+            quint64 bits;
+            memcpy(&bits, &d, sizeof(bits));
+            for (int i = 0; i < 8; ++i) {
+                writeByte(static_cast<quint8>(bits >> (i * 8)));
+            }
+            return;
+        }
+        default:
+            break;
+        }
+
+        if (value.userType() == qMetaTypeId<NotificationImage>()) {
+            // Raw pixel data, in the same form as transmitted over D-Bus
+            const NotificationImage image(value.value<NotificationImage>());
+            writeByte(CodecImage);
+            writeVarint(image.width());
+            writeVarint(image.height());
+            writeVarint(image.bytesPerLine());
+            writeByte(image.hasAlphaChannel() ? 1 : 0);
+            writeBytes(reinterpret_cast<const char *>(image.constBits()), image.bytesPerLine() * image.height());
+        } else if (value.isValid()) {
+            // Anything else, such as the remote action input maps, uses the generic serialization
+            QByteArray serialized;
+            QDataStream stream(&serialized, QIODevice::WriteOnly);
+            stream << value;
+            writeByte(CodecVariant);
+            writeBytes(serialized.constData(), serialized.size());
         } else {
-            qWarning() << "Supplied DBus connection is not connected.";
+            writeByte(CodecInvalid);
         }
-    } else {
-        qWarning() << "Cannot override DBus connection - notifications already exist.";
     }
-    return false;
+
+    void writeNotification(const NotificationData &data)
+    {
+        writeString(data.appName());
+        writeVarint(data.replacesId());
+        writeString(data.appIcon());
+        writeString(data.summary());
+        writeString(data.body());
+
+        writeVarint(data.actions().count());
+        for (const NotificationData::ActionInfo &actionInfo : data.actions()) {
+            writeString(actionInfo.name);
+            writeString(actionInfo.displayName);
+        }
+
+        // Hints are written in key order, so that equal content has an identical encoding
+        const QHash<QString, int> &indices(codecHintIndices());
+        const QVariantHash &hints(data.hints());
+        QStringList keys(hints.keys());
+        std::sort(keys.begin(), keys.end());
+        writeVarint(keys.count());
+        for (const QString &key : keys) {
+            // Zero is followed by the key itself, otherwise the key is index + 1
+            QHash<QString, int>::const_iterator index = indices.constFind(key);
+            if (index != indices.constEnd()) {
+                writeVarint(index.value() + 1);
+            } else {
+                writeVarint(0);
+                writeString(key);
+            }
+            writeValue(hints.value(key));
+        }
+
+        writeSigned(data.expireTimeout());
+    }
+
+private:
+    QByteArray *m_buffer;
+};
+
+class CodecReader
+{
+public:
+    CodecReader(const QByteArray &buffer, NotificationDataCodec::StringMode mode)
+        : m_begin(buffer.constData())
+        , m_pos(m_begin)
+        , m_end(m_begin + buffer.size())
+        , m_reference(mode == NotificationDataCodec::ReferenceStrings)
+    {
+    }
+
+    bool ok() const
+    {
+        return m_ok;
+    }
+
+    const char *readRaw(quint64 size)
+    {
+        if (!m_ok || size > static_cast<quint64>(m_end - m_pos)) {
+            m_ok = false;
+            return nullptr;
+        }
+        const char *rv = m_pos;
+        m_pos += size;
+        return rv;
+    }
+
+    quint8 readByte()
+    {
+        const char *p = readRaw(1);
+        return p ? static_cast<quint8>(*p) : 0;
+    }
+
+    quint64 readVarint()
+    {
+        quint64 rv = 0;
+        for (int shift = 0; shift < 64 && m_ok; shift += 7) {
+            const quint8 byte = readByte();
+            rv |= static_cast<quint64>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return rv;
+            }
+        }
+        m_ok = false;
+        return 0;
+    }
+
+    qint64 readSigned()
+    {
+        const quint64 value = readVarint();
+        return static_cast<qint64>(value >> 1) ^ -static_cast<qint64>(value & 1);
+    }
+
+    int readSize()
+    {
+        const quint64 size = readVarint();
+        if (size > static_cast<quint64>(m_end - m_pos)) {
+            m_ok = false;
+            return 0;
+        }
+        return static_cast<int>(size);
+    }
+
+    QByteArray readBytes()
+    {
+        const int size = readSize();
+        const char *p = readRaw(size);
+        return p ? QByteArray(p, size) : QByteArray();
+    }
+
+    QString readString()
+    {
+        const int size = readSize();
+        if ((m_pos - m_begin) & 1) {
+            readByte();
+        }
+        const char *p = readRaw(static_cast<quint64>(size) * 2);
+        if (!p) {
+            return QString();
+        }
+
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        if (m_reference && (reinterpret_cast<quintptr>(p) & 1) == 0) {
+            return QString::fromRawData(reinterpret_cast<const QChar *>(p), size);
+        }
+#endif
+        QString rv(size, Qt::Uninitialized);
+        QChar *out = rv.data();
+        for (int i = 0; i < size; ++i) {
+            out[i] = QChar(static_cast<ushort>(static_cast<quint8>(p[i * 2]) | (static_cast<quint8>(p[i * 2 + 1]) << 8)));
+        }
+        return rv;
+    }
+
+    QVariant readValue()
+    {
+        switch (readByte()) {
+        case CodecInvalid:
+            return QVariant();
+        case CodecString:
+            return readString();
+        case CodecInt:
+            return static_cast<int>(readSigned());
+        case CodecUInt:
+            return static_cast<uint>(readVarint());
+        case CodecLongLong:
+            return static_cast<qlonglong>(readSigned());
+        case CodecULongLong:
+            return static_cast<qulonglong>(readVarint());
+        case CodecBool:
+            return readByte() != 0;
+        case CodecDouble: {
+            quint64 bits = 0;
+            for (int i = 0; i < 8; ++i) {
+                bits |= static_cast<quint64>(readByte()) << (i * 8);
+            }
+            double d;
+            memcpy(&d, &bits, sizeof(d));
+            return d;
+        }
+        case CodecImage: {
+            const int width = readSize();
+            const int height = readSize();
+            const int bytesPerLine = readSize();
+            const bool alpha = readByte() != 0;
+            const QByteArray bits(readBytes());
+            if (!m_ok || bits.size() < static_cast<qint64>(bytesPerLine) * height) {
+                m_ok = false;
+                return QVariant();
+            }
+            const QImage image(reinterpret_cast<const uchar *>(bits.constData()), width, height, bytesPerLine,
+                               alpha ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+            return QVariant::fromValue(NotificationImage(image.copy()));
+        }
+        case CodecVariant: {
+            const QByteArray serialized(readBytes());
+            QDataStream stream(serialized);
+            QVariant value;
+            stream >> value;
+            return value;
+        }
+        default:
+            m_ok = false;
+            return QVariant();
+        }
+    }
+
+    void readNotification(NotificationData *data)
+    {
+        data->setAppName(readString());
+        data->setReplacesId(static_cast<quint32>(readVarint()));
+        data->setAppIcon(readString());
+        data->setSummary(readString());
+        data->setBody(readString());
+
+        QList<NotificationData::ActionInfo> actions;
+        const int actionCount = readSize();
+        for (int i = 0; i < actionCount && m_ok; ++i) {
+            NotificationData::ActionInfo actionInfo;
+            actionInfo.name = readString();
+            actionInfo.displayName = readString();
+            actions.append(actionInfo);
+        }
+        data->setActions(actions);
+
+        const QStringList &keys(codecHintKeys());
+        QVariantHash hints;
+        const int hintCount = readSize();
+        hints.reserve(hintCount);
+        for (int i = 0; i < hintCount && m_ok; ++i) {
+            const quint64 index = readVarint();
+            QString key;
+            if (index == 0) {
+                key = readString();
+            } else if (index <= static_cast<quint64>(keys.count())) {
+                key = keys.at(static_cast<int>(index - 1));
+            } else {
+                m_ok = false;
+                break;
+            }
+            hints.insert(key, readValue());
+        }
+        data->setHints(hints);
+
+        data->setExpireTimeout(static_cast<qint32>(readSigned()));
+    }
+
+private:
+    const char *m_begin;
+    const char *m_pos;
+    const char *m_end;
+    bool m_reference;
+    bool m_ok = true;
+};
+
+}
+
+QByteArray NotificationDataCodec::encode(const QList<NotificationData> &notifications)
+{
+    QByteArray buffer;
+    buffer.append(CODEC_MAGIC, sizeof(CODEC_MAGIC));
+
+    CodecWriter writer(&buffer);
+    writer.writeByte(CODEC_VERSION);
+    writer.writeVarint(notifications.count());
+    for (const NotificationData &data : notifications) {
+        writer.writeNotification(data);
+    }
+    return buffer;
+}
+
+bool NotificationDataCodec::decode(const QByteArray &buffer, QList<NotificationData> *notifications, StringMode mode)
+{
+    if (!buffer.startsWith(QByteArray::fromRawData(CODEC_MAGIC, sizeof(CODEC_MAGIC)))) {
+        return false;
+    }
+
+    CodecReader reader(buffer, mode);
+    reader.readRaw(sizeof(CODEC_MAGIC));
+    const quint8 version = reader.readByte();
+    if (version != CODEC_VERSION) {
+        qWarning() << "Unsupported notification encoding version:" << version;
+        return false;
+    }
+
+    QList<NotificationData> rv;
+    const int count = reader.readSize();
+    rv.reserve(count);
+    for (int i = 0; i < count && reader.ok(); ++i) {
+        NotificationData data;
+        reader.readNotification(&data);
+        rv.append(data);
+    }
+
+    if (!reader.ok()) {
+        return false;
+    }
+    *notifications = rv;
+    return true;
+}
+
+namespace {
+
+// Strings decoded from one listing reply. Values repeated across the entries are
+// stored once and shared by all of them, and are released together with the listing
+class ReplyStrings
+{
+public:
+    QString key(const QString &key)
+    {
+        // Well-known hint names are shared with the static keys
+        const QHash<QString, int> &indices(codecHintIndices());
+        QHash<QString, int>::const_iterator it = indices.constFind(key);
+        if (it != indices.constEnd()) {
+            return codecHintKeys().at(it.value());
+        }
+        return string(key);
+    }
+
+    QString string(const QString &string)
+    {
+        if (string.isEmpty()) {
+            return QString();
+        }
+
+        QSet<QString>::const_iterator it = m_strings.constFind(string);
+        if (it != m_strings.constEnd()) {
+            return *it;
+        }
+        m_strings.insert(string);
+        return string;
+    }
+
+    QVariant value(const QVariant &value)
+    {
+        if (value.type() == QVariant::String) {
+            return string(value.toString());
+        }
+        return value;
+    }
+
+private:
+    QSet<QString> m_strings;
+};
+
+void readNotificationData(const QDBusArgument &argument, NotificationData *data, ReplyStrings *strings)
+{
+    QString string;
+    quint32 replacesId = 0;
+    qint32 expireTimeout = -1;
+
+    argument.beginStructure();
+    argument >> string;
+    data->setAppName(strings->string(string));
+    argument >> replacesId;
+    data->setReplacesId(replacesId);
+    argument >> string;
+    data->setAppIcon(strings->string(string));
+    argument >> string;
+    data->setSummary(string);
+    argument >> string;
+    data->setBody(string);
+
+    // Decode the action pairs directly, rather than through an intermediate list
+    QList<NotificationData::ActionInfo> actions;
+    argument.beginArray();
+    while (!argument.atEnd()) {
+        NotificationData::ActionInfo actionInfo;
+        argument >> string;
+        actionInfo.name = strings->string(string);
+        if (!argument.atEnd()) {
+            argument >> string;
+            actionInfo.displayName = strings->string(string);
+        }
+        actions.append(actionInfo);
+    }
+    argument.endArray();
+    data->setActions(actions);
+
+    QVariantHash hints;
+    argument.beginMap();
+    while (!argument.atEnd()) {
+        QDBusVariant value;
+        argument.beginMapEntry();
+        argument >> string >> value;
+        argument.endMapEntry();
+        hints.insert(strings->key(string), strings->value(value.variant()));
+    }
+    argument.endMap();
+    data->setHints(hints);
+
+    argument >> expireTimeout;
+    data->setExpireTimeout(expireTimeout);
+    argument.endStructure();
+}
+
+}
+
+// Listing replies are decoded as a whole, so that the entries can share their common strings
+const QDBusArgument &operator>>(const QDBusArgument &argument, QList<NotificationData> &notifications)
+{
+    ReplyStrings strings;
+
+    notifications.clear();
+    argument.beginArray();
+    while (!argument.atEnd()) {
+        NotificationData data;
+        readNotificationData(argument, &data, &strings);
+        notifications.append(data);
+    }
+    argument.endArray();
+
+    return argument;
+}
+
+class NotificationTablePrivate : public QSharedData
+{
+public:
+    void append(uint id, int urgency, qint64 timestamp, int itemCount,
+                const QString &category, const QString &owner, const QString &appName)
+    {
+        ids.append(id);
+        urgencies.append(qMax(static_cast<int>(Notification::Low), qMin(static_cast<int>(Notification::Critical), urgency)));
+        timestamps.append(timestamp);
+        itemCounts.append(itemCount);
+        categoryIndices.append(index(&categories, &categoryLookup, category));
+        ownerIndices.append(index(&owners, &ownerLookup, owner));
+        appNameIndices.append(index(&appNames, &appNameLookup, appName));
+    }
+
+    void append(const NotificationData &data)
+    {
+        const QVariantHash &hints(data.hints());
+        const QDateTime timestamp(hints.value(HINT_TIMESTAMP).toDateTime());
+        append(data.replacesId(), hints.value(HINT_URGENCY).toInt(),
+               timestamp.isValid() ? timestamp.toMSecsSinceEpoch() : 0,
+               hints.value(HINT_ITEM_COUNT).toInt(),
+               hints.value(HINT_CATEGORY).toString(), hints.value(HINT_OWNER).toString(), data.appName());
+    }
+
+    QVector<uint> ids;
+    QVector<int> urgencies;
+    QVector<qint64> timestamps;
+    QVector<int> itemCounts;
+    QVector<int> categoryIndices;
+    QVector<int> ownerIndices;
+    QVector<int> appNameIndices;
+    QStringList categories;
+    QStringList owners;
+    QStringList appNames;
+
+private:
+    static int index(QStringList *dictionary, QHash<QString, int> *lookup, const QString &value)
+    {
+        QHash<QString, int>::const_iterator it = lookup->constFind(value);
+        if (it != lookup->constEnd()) {
+            return it.value();
+        }
+        dictionary->append(value);
+        lookup->insert(value, dictionary->count() - 1);
+        return dictionary->count() - 1;
+    }
+
+    QHash<QString, int> categoryLookup;
+    QHash<QString, int> ownerLookup;
+    QHash<QString, int> appNameLookup;
+};
+
+QDBusArgument &operator<<(QDBusArgument &argument, const NotificationTable &)
+{
+    // Tables are only received; this describes them as a listing reply
+    argument.beginArray(qMetaTypeId<NotificationData>());
+    argument.endArray();
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, NotificationTable &table)
+{
+    table = NotificationTable();
+    NotificationTablePrivate *d = table.d.data();
+
+    QString string;
+    QDBusVariant value;
+    qint32 expireTimeout;
+
+    argument.beginArray();
+    while (!argument.atEnd()) {
+        QString appName;
+        uint id = 0;
+        QString category;
+        QString owner;
+        int urgency = 0;
+        qint64 timestamp = 0;
+        int itemCount = 0;
+
+        argument.beginStructure();
+        argument >> appName >> id;
+        // The icon, summary, body and actions are not tabulated
+        argument >> string >> string >> string;
+        argument.beginArray();
+        while (!argument.atEnd()) {
+            argument >> string;
+        }
+        argument.endArray();
+
+        argument.beginMap();
+        while (!argument.atEnd()) {
+            argument.beginMapEntry();
+            argument >> string >> value;
+            argument.endMapEntry();
+            if (string == HINT_CATEGORY) {
+                category = value.variant().toString();
+            } else if (string == HINT_OWNER) {
+                owner = value.variant().toString();
+            } else if (string == HINT_URGENCY) {
+                urgency = value.variant().toInt();
+            } else if (string == HINT_TIMESTAMP) {
+                const QDateTime dateTime(value.variant().toDateTime());
+                timestamp = dateTime.isValid() ? dateTime.toMSecsSinceEpoch() : 0;
+            } else if (string == HINT_ITEM_COUNT) {
+                itemCount = value.variant().toInt();
+            }
+        }
+        argument.endMap();
+        argument >> expireTimeout;
+        argument.endStructure();
+
+        d->append(id, urgency, timestamp, itemCount, category, owner, appName);
+    }
+    argument.endArray();
+
+    return argument;
+}
+
+namespace {
+
+// Decodes a listing reply away from the thread that received it
+class ListingDecoder : public QRunnable
+{
+public:
+    ListingDecoder(const QDBusMessage &reply, const QFutureInterface<QList<NotificationData> > &result)
+        : m_reply(reply)
+        , m_result(result)
+    {
+    }
+
+    void run() override
+    {
+        QList<NotificationData> notifications;
+        const QList<QVariant> arguments(m_reply.arguments());
+        if (!arguments.isEmpty()) {
+            notifications = qdbus_cast<QList<NotificationData> >(arguments.first());
+        }
+        m_result.reportResult(notifications);
+        m_result.reportFinished();
+    }
+
+private:
+    QDBusMessage m_reply;
+    QFutureInterface<QList<NotificationData> > m_result;
+};
+
+}
+
+NotificationConnectionManager::NotificationConnectionManager()
+    : QObject()
+    , m_offlineQueue(new NotificationOfflineQueue)
+    , m_ownerListings(new NotificationListingCache)
+    , m_categoryListings(new NotificationListingCache)
+    , m_publishScheduler(new NotificationPublishScheduler)
+    , m_groups(new NotificationGroups)
+    , m_duplicateFilter(new NotificationDuplicateFilter)
+    , m_publishStatistics(new NotificationPublishStatistics)
+{
+    connect(this, SIGNAL(NotificationClosed(uint,uint)), this, SLOT(notificationClosed(uint)));
+}
+
+NotificationConnectionManager::~NotificationConnectionManager()
+{
+    // Notifications returned by listings are parented to us; delete them while our state is intact
+    qDeleteAll(findChildren<Notification *>(QString(), Qt::FindDirectChildrenOnly));
+}
+
+NotificationManagerProxy *NotificationConnectionManager::notificationManager()
+{
+    if (proxy.isNull()) {
+        qDBusRegisterMetaType<NotificationData>();
+        qDBusRegisterMetaType<QList<NotificationData> >();
+        qDBusRegisterMetaType<NotificationImage>();
+        qDBusRegisterMetaType<NotificationTable>();
+        createProxy();
+    }
+    return proxy.data();
+}
+
+void NotificationConnectionManager::createProxy()
+{
+    QString serviceName(DBUS_SERVICE);
+    QDBusConnection *conn = dBusConnection.data();
+    if (conn && conn->isConnected() && conn->baseService().isEmpty()) {
+        // p2p connection - no service name
+        serviceName.clear();
+    }
+    const QDBusConnection bus(conn ? *conn : QDBusConnection::sessionBus());
+
+    if (!proxy.isNull()) {
+        // The capabilities of a new instance of the service are not known yet
+        for (const QString &owner : m_subscribedOwners) {
+            subscribeOwner(owner, false);
+        }
+        m_subscribedOwners.clear();
+    }
+    m_ownerSignals = OwnerSignalsUnknown;
+
+    proxy.reset(new NotificationManagerProxy(serviceName, DBUS_PATH, bus));
+    m_subscribed = false;
+    updateSubscriptions();
+
+    if (!m_serviceWatcher && !serviceName.isEmpty()) {
+        m_serviceWatcher = new QDBusServiceWatcher(serviceName, bus, QDBusServiceWatcher::WatchForOwnerChange, this);
+        connect(m_serviceWatcher, SIGNAL(serviceOwnerChanged(QString,QString,QString)),
+                this, SLOT(serviceOwnerChanged(QString,QString,QString)));
+    }
+}
+
+void NotificationConnectionManager::serviceOwnerChanged(const QString &, const QString &, const QString &newOwner)
+{
+    // Listings from the previous instance of the service may no longer be accurate
+    clearListingCache();
+    m_duplicateFilter->clear();
+    m_closeAllUnsupported = false;
+
+    // Group summaries do not survive the service; the next update of each group creates a new one
+    m_groups->resetIds();
+
+    // Nor do any other notifications
+    resetNotificationIds();
+
+    if (newOwner.isEmpty()) {
+        // Wait for the service to be restarted
+        return;
+    }
+
+    // Any state held by the existing proxy refers to the previous instance of the service
+    createProxy();
+    emit serviceRestarted();
+
+    drainOfflineQueue();
+
+    if (!m_replayQueue.isEmpty()) {
+        startReplay();
+    }
+}
+
+void NotificationConnectionManager::resetNotificationIds()
+{
+    QSet<Notification *> queued;
+    for (const QPointer<Notification> &notification : m_replayQueue) {
+        queued.insert(notification.data());
+    }
+
+    // Clearing an ID notifies the application, which may delete the notification
+    QList<QPointer<Notification> > notifications;
+    for (Notification *notification : m_notifications) {
+        notifications.append(notification);
+    }
+
+    for (const QPointer<Notification> &notification : notifications) {
+        if (!notification) {
+            continue;
+        }
+        if (m_replayResident && notification->resident() && !queued.contains(notification.data())) {
+            if (m_replayQueue.count() < m_replayLimit) {
+                queued.insert(notification.data());
+                m_replayQueue.append(notification);
+            } else {
+                qWarning() << "Not replaying more than" << m_replayLimit << "notifications";
+            }
+        }
+        notification->setReplacesId(0);
+    }
+}
+
+void NotificationConnectionManager::startReplay()
+{
+    if (!m_replaying) {
+        m_replaying = true;
+        m_replayCount = 0;
+        m_replayTimer.start();
+        QMetaObject::invokeMethod(this, "replayNextBatch", Qt::QueuedConnection);
+    }
+}
+
+void NotificationConnectionManager::replayNextBatch()
+{
+    // Publish a limited number at a time so that the event loop is not starved
+    for (int i = 0; i < m_replayBatchSize && !m_replayQueue.isEmpty(); ++i) {
+        // A notification already published again by the application is not replayed
+        QPointer<Notification> notification = m_replayQueue.takeFirst();
+        if (notification && notification->replacesId() == 0) {
+            notification->publish();
+            ++m_replayCount;
+        }
+    }
+
+    if (!m_replayQueue.isEmpty()) {
+        QMetaObject::invokeMethod(this, "replayNextBatch", Qt::QueuedConnection);
+    } else {
+        m_replaying = false;
+        m_lastReplayCount = m_replayCount;
+        m_lastReplayDuration = m_replayTimer.elapsed();
+        emit replayFinished(m_lastReplayCount, m_lastReplayDuration);
+    }
+}
+
+void NotificationConnectionManager::notificationIdChanged(Notification *notification, uint previousId, uint id)
+{
+    // The subscriptions depend only on which owners have notifications, so they are
+    // updated only when an owner gains its first notification or loses its last
+    const bool hadNotifications = !m_notifications.isEmpty();
+    bool ownersChanged = false;
+
+    if (previousId != 0) {
+        m_notifications.remove(previousId, notification);
+
+        QHash<Notification *, QString>::iterator it = m_notificationOwners.find(notification);
+        if (it != m_notificationOwners.end()) {
+            if (--m_ownerCounts[it.value()] == 0) {
+                m_ownerCounts.remove(it.value());
+                ownersChanged = true;
+            }
+            m_notificationOwners.erase(it);
+        }
+    }
+    if (id != 0) {
+        m_notifications.insert(id, notification);
+
+        // The owner may have changed since the notification was last published
+        const QString owner(notification->hintValue(HINT_OWNER).toString());
+        const QString key(owner.isEmpty() ? processName() : owner);
+        m_notificationOwners.insert(notification, key);
+        if (++m_ownerCounts[key] == 1) {
+            ownersChanged = true;
+        }
+
+        if (proxy.isNull()) {
+            // Signals for this notification are received through the proxy
+            notificationManager();
+        }
+    } else {
+        // Closed or destroyed; there is nothing left to update
+        m_progressUpdates.remove(notification);
+    }
+
+    if (ownersChanged || hadNotifications != !m_notifications.isEmpty()) {
+        updateSubscriptions();
+    }
+}
+
+void NotificationConnectionManager::updateSubscriptions()
+{
+    if (proxy.isNull()) {
+        return;
+    }
+
+    // The proxy adds the bus match rules for a signal while it has connections, so
+    // the signals are only delivered to us while something depends on them
+    const bool wanted = !m_notifications.isEmpty() || !m_groups->isEmpty() || m_listingCacheEnabled;
+    if (wanted && m_ownerSignals == OwnerSignalsUnknown) {
+        m_ownerSignals = OwnerSignalsQuerying;
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(proxy->GetCapabilities(), this);
+        connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(capabilitiesReceived(QDBusPendingCallWatcher*)));
+    }
+
+    // If the server supports it, receive only the signals for the owners of our notifications.
+    // Cached category listings may hold notifications of any owner, so they need every signal
+    const bool scoped = wanted && m_ownerSignals == OwnerSignalsSupported && m_categoryListings->isEmpty();
+    QSet<QString> owners;
+    if (scoped) {
+        for (QHash<QString, int>::const_iterator it = m_ownerCounts.constBegin(); it != m_ownerCounts.constEnd(); ++it) {
+            owners.insert(it.key());
+        }
+        for (const QString &owner : m_groups->owners()) {
+            owners.insert(owner.isEmpty() ? processName() : owner);
+        }
+        for (const QString &owner : m_ownerListings->keys()) {
+            owners.insert(owner);
+        }
+        if (m_listingCacheEnabled) {
+            owners.insert(processName());
+        }
+    }
+    for (const QString &owner : m_subscribedOwners - owners) {
+        subscribeOwner(owner, false);
+    }
+    for (const QString &owner : owners - m_subscribedOwners) {
+        subscribeOwner(owner, true);
+    }
+    m_subscribedOwners = owners;
+
+    const bool subscribe = wanted && !scoped;
+    if (subscribe == m_subscribed) {
+        return;
+    }
+
+    m_subscribed = subscribe;
+    if (subscribe) {
+        connect(proxy.data(), SIGNAL(ActionInvoked(uint,QString)), this, SLOT(dispatchActionInvoked(uint,QString)));
+        connect(proxy.data(), SIGNAL(NotificationClosed(uint,uint)), this, SLOT(dispatchNotificationClosed(uint,uint)));
+        connect(proxy.data(), SIGNAL(InputTextSet(uint,QString)), this, SLOT(dispatchInputTextSet(uint,QString)));
+    } else {
+        disconnect(proxy.data(), SIGNAL(ActionInvoked(uint,QString)), this, SLOT(dispatchActionInvoked(uint,QString)));
+        disconnect(proxy.data(), SIGNAL(NotificationClosed(uint,uint)), this, SLOT(dispatchNotificationClosed(uint,uint)));
+        disconnect(proxy.data(), SIGNAL(InputTextSet(uint,QString)), this, SLOT(dispatchInputTextSet(uint,QString)));
+    }
+}
+
+QStringList NotificationConnectionManager::subscribedOwners() const
+{
+    QStringList owners(m_subscribedOwners.toList());
+    std::sort(owners.begin(), owners.end());
+    return owners;
+}
+
+namespace {
+
+QList<QPointer<Notification> > notificationsWithId(const QMultiHash<uint, Notification *> &notifications, uint id)
+{
+    // Handlers may change IDs or delete notifications, so take a guarded copy
+    QList<QPointer<Notification> > rv;
+    QMultiHash<uint, Notification *>::const_iterator it = notifications.constFind(id);
+    for ( ; it != notifications.constEnd() && it.key() == id; ++it) {
+        rv.append(it.value());
+    }
+    return rv;
+}
+
+}
+
+void NotificationConnectionManager::dispatchActionInvoked(uint id, const QString &actionKey)
+{
+    for (const QPointer<Notification> &notification : notificationsWithId(m_notifications, id)) {
+        if (notification) {
+            notification->checkActionInvoked(id, actionKey);
+        }
+    }
+    emit ActionInvoked(id, actionKey);
+}
+
+void NotificationConnectionManager::subscribeOwner(const QString &owner, bool subscribe)
+{
+    QDBusConnection bus(proxy->connection());
+    const QString service(proxy->service());
+    const QString path(proxy->path());
+    const QString interface(proxy->interface());
+    const QStringList match(owner);
+
+    if (subscribe) {
+        bus.connect(service, path, interface, QStringLiteral("OwnerActionInvoked"), match, QString(),
+                    this, SLOT(dispatchOwnerActionInvoked(QString,uint,QString)));
+        bus.connect(service, path, interface, QStringLiteral("OwnerNotificationClosed"), match, QString(),
+                    this, SLOT(dispatchOwnerNotificationClosed(QString,uint,uint)));
+        bus.connect(service, path, interface, QStringLiteral("OwnerInputTextSet"), match, QString(),
+                    this, SLOT(dispatchOwnerInputTextSet(QString,uint,QString)));
+    } else {
+        bus.disconnect(service, path, interface, QStringLiteral("OwnerActionInvoked"), match, QString(),
+                       this, SLOT(dispatchOwnerActionInvoked(QString,uint,QString)));
+        bus.disconnect(service, path, interface, QStringLiteral("OwnerNotificationClosed"), match, QString(),
+                       this, SLOT(dispatchOwnerNotificationClosed(QString,uint,uint)));
+        bus.disconnect(service, path, interface, QStringLiteral("OwnerInputTextSet"), match, QString(),
+                       this, SLOT(dispatchOwnerInputTextSet(QString,uint,QString)));
+    }
+}
+
+void NotificationConnectionManager::capabilitiesReceived(QDBusPendingCallWatcher *watcher)
+{
+    watcher->deleteLater();
+    if (m_ownerSignals != OwnerSignalsQuerying) {
+        // Superseded by a restart of the service
+        return;
+    }
+
+    QDBusPendingReply<QStringList> reply(*watcher);
+    m_ownerSignals = !reply.isError() && reply.value().contains(QStringLiteral("x-nemo-owner-signals"))
+            ? OwnerSignalsSupported
+            : OwnerSignalsUnsupported;
+    updateSubscriptions();
+}
+
+void NotificationConnectionManager::dispatchOwnerActionInvoked(const QString &, uint id, const QString &actionKey)
+{
+    dispatchActionInvoked(id, actionKey);
+}
+
+void NotificationConnectionManager::dispatchOwnerNotificationClosed(const QString &, uint id, uint reason)
+{
+    dispatchNotificationClosed(id, reason);
+}
+
+void NotificationConnectionManager::dispatchOwnerInputTextSet(const QString &, uint id, const QString &inputText)
+{
+    dispatchInputTextSet(id, inputText);
+}
+
+void NotificationConnectionManager::dispatchNotificationClosed(uint id, uint reason)
+{
+    for (const QPointer<Notification> &notification : notificationsWithId(m_notifications, id)) {
+        if (notification) {
+            notification->checkNotificationClosed(id, reason);
+        }
+    }
+    emit NotificationClosed(id, reason);
+}
+
+void NotificationConnectionManager::dispatchInputTextSet(uint id, const QString &inputText)
+{
+    for (const QPointer<Notification> &notification : notificationsWithId(m_notifications, id)) {
+        if (notification) {
+            notification->checkInputTextSet(id, inputText);
+        }
+    }
+    emit InputTextSet(id, inputText);
+}
+
+bool NotificationConnectionManager::replayResidentNotifications() const
+{
+    return m_replayResident;
+}
+
+void NotificationConnectionManager::setReplayResidentNotifications(bool replay)
+{
+    m_replayResident = replay;
+}
+
+int NotificationConnectionManager::replayBatchSize() const
+{
+    return m_replayBatchSize;
+}
+
+void NotificationConnectionManager::setReplayBatchSize(int size)
+{
+    m_replayBatchSize = qMax(1, size);
+}
+
+int NotificationConnectionManager::replayLimit() const
+{
+    return m_replayLimit;
+}
+
+void NotificationConnectionManager::setReplayLimit(int limit)
+{
+    m_replayLimit = qMax(0, limit);
+}
+
+int NotificationConnectionManager::lastReplayCount() const
+{
+    return m_lastReplayCount;
+}
+
+qint64 NotificationConnectionManager::lastReplayDuration() const
+{
+    return m_lastReplayDuration;
+}
+
+int NotificationConnectionManager::offlineQueueLimit() const
+{
+    return m_offlineQueue->limit();
+}
+
+void NotificationConnectionManager::setOfflineQueueLimit(int limit)
+{
+    m_offlineQueue->setLimit(limit);
+}
+
+QString NotificationConnectionManager::offlineQueueFile() const
+{
+    return m_offlineQueue->file();
+}
+
+void NotificationConnectionManager::setOfflineQueueFile(const QString &path)
+{
+    if (m_offlineQueue->file() != path) {
+        m_offlineQueue->setFile(path);
+        drainOfflineQueue();
+    }
+}
+
+int NotificationConnectionManager::offlineQueueSize() const
+{
+    return m_offlineQueue->count() + m_offlineCalls.count();
+}
+
+bool NotificationConnectionManager::enqueueOffline(const NotificationData &data, Notification *notification)
+{
+    // Without a service name, we cannot tell when the service appears
+    if (m_offlineQueue->limit() == 0 || !m_serviceWatcher) {
+        return false;
+    }
+
+    m_offlineQueue->enqueue(data, notification);
+    return true;
+}
+
+void NotificationConnectionManager::cancelOffline(Notification *notification)
+{
+    m_offlineQueue->cancel(notification);
+}
+
+void NotificationConnectionManager::drainOfflineQueue()
+{
+    if (!m_offlineQueue->isDraining() && !m_offlineQueue->isEmpty()) {
+        m_offlineQueue->setDraining(true);
+        m_offlineDrainFailed = false;
+        m_offlineDrained = 0;
+        QMetaObject::invokeMethod(this, "drainNextBatch", Qt::QueuedConnection);
+    }
+}
+
+void NotificationConnectionManager::drainNextBatch()
+{
+    NotificationManagerProxy *proxy = notificationManager();
+
+    // Publish a batch concurrently, and wait for it to complete before sending the next
+    for (int i = 0; i < m_replayBatchSize && !m_offlineQueue->isEmpty(); ++i) {
+        QueuedNotification queued(m_offlineQueue->takeFirst());
+        const NotificationData &data(queued.data);
+        queued.sent.start();
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
+                    proxy->Notify(data.appName(), data.replacesId(), data.appIcon(), data.summary(), data.body(),
+                                  encodeActions(data.actions()), data.hints(), data.expireTimeout()), this);
+        connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(offlinePublishFinished(QDBusPendingCallWatcher*)));
+        m_offlineCalls.insert(watcher, queued);
+    }
+}
+
+void NotificationConnectionManager::offlinePublishFinished(QDBusPendingCallWatcher *watcher)
+{
+    const QueuedNotification queued(m_offlineCalls.take(watcher));
+    watcher->deleteLater();
+
+    QDBusPendingReply<uint> reply(*watcher);
+    publishCompleted(queued.sent.nsecsElapsed() / 1000, !reply.isError());
+    if (reply.isError()) {
+        if (isServiceUnavailable(reply.error())) {
+            // The service has gone again; retain the entry unless it has since been superseded
+            m_offlineQueue->requeue(queued);
+            m_offlineDrainFailed = true;
+        } else {
+            qWarning() << "Unable to publish queued notification:" << reply.error().message();
+        }
+    } else {
+        ++m_offlineDrained;
+        if (queued.notification && queued.notification->replacesId() == queued.data.replacesId()) {
+            queued.notification->setReplacesId(reply.value());
+        }
+        if (m_listingCacheEnabled) {
+            NotificationData data(queued.data);
+            data.setReplacesId(reply.value());
+            notificationPublished(queued.data.replacesId(), data);
+        }
+    }
+
+    if (!m_offlineCalls.isEmpty()) {
+        return;
+    }
+
+    if (!m_offlineDrainFailed && !m_offlineQueue->isEmpty()) {
+        drainNextBatch();
+        return;
+    }
+
+    m_offlineQueue->setDraining(false);
+    if (!m_offlineDrainFailed) {
+        emit offlineQueueDrained(m_offlineDrained);
+    }
+}
+
+bool NotificationConnectionManager::listingCacheEnabled() const
+{
+    return m_listingCacheEnabled;
+}
+
+void NotificationConnectionManager::setListingCacheEnabled(bool enabled)
+{
+    if (m_listingCacheEnabled != enabled) {
+        m_listingCacheEnabled = enabled;
+        clearListingCache();
+        // The cache is maintained from the NotificationClosed signal
+        updateSubscriptions();
+    }
+}
+
+quint64 NotificationConnectionManager::listingCacheHits() const
+{
+    return m_ownerListings->hits() + m_categoryListings->hits();
+}
+
+quint64 NotificationConnectionManager::listingCacheMisses() const
+{
+    return m_ownerListings->misses() + m_categoryListings->misses();
+}
+
+void NotificationConnectionManager::clearListingCache()
+{
+    m_ownerListings->clear();
+    m_categoryListings->clear();
+    updateSubscriptions();
+}
+
+QList<NotificationData> NotificationConnectionManager::notifications(const QString &owner)
+{
+    if (m_listingCacheEnabled) {
+        if (const QList<NotificationData> *listing = m_ownerListings->find(owner)) {
+            return *listing;
+        }
+    }
+
+    QDBusPendingReply<QList<NotificationData> > reply = notificationManager()->GetNotifications(owner);
+    reply.waitForFinished();
+    if (reply.isError()) {
+        return QList<NotificationData>();
+    }
+
+    const QList<NotificationData> listing(reply.value());
+    if (m_listingCacheEnabled) {
+        m_ownerListings->insert(owner, listing);
+        updateSubscriptions();
+    }
+    return listing;
+}
+
+QList<NotificationData> NotificationConnectionManager::notificationsByCategory(const QString &category)
+{
+    if (m_listingCacheEnabled) {
+        if (const QList<NotificationData> *listing = m_categoryListings->find(category)) {
+            return *listing;
+        }
+    }
+
+    QDBusPendingReply<QList<NotificationData> > reply = notificationManager()->GetNotificationsByCategory(category);
+    reply.waitForFinished();
+    if (reply.isError()) {
+        return QList<NotificationData>();
+    }
+
+    const QList<NotificationData> listing(reply.value());
+    if (m_listingCacheEnabled) {
+        m_categoryListings->insert(category, listing);
+        updateSubscriptions();
+    }
+    return listing;
+}
+
+int NotificationConnectionManager::groupingWindow() const
+{
+    return m_groups->window();
+}
+
+void NotificationConnectionManager::setGroupingWindow(int milliseconds)
+{
+    m_groups->setWindow(milliseconds);
+    if (m_groupTimer && m_groupTimer->isActive()) {
+        m_groupTimer->stop();
+        flushGroups();
+    }
+}
+
+quint64 NotificationConnectionManager::collapsedGroupUpdates() const
+{
+    return m_groups->collapsedUpdates();
+}
+
+bool NotificationConnectionManager::bundleGrouped(const QString &groupId, NotificationData *data, Notification *notification)
+{
+    const bool created = !m_groups->contains(groupId);
+    const bool held = m_groups->bundle(groupId, data, notification);
+    if (created) {
+        // Groups are forgotten when their summary is closed
+        updateSubscriptions();
+    }
+    if (held) {
+        scheduleGroupFlush(m_groups->flushDelay(groupId));
+    }
+    return held;
+}
+
+void NotificationConnectionManager::groupPublished(const QString &groupId, uint id)
+{
+    // Called with a zero ID if the publication failed
+    if (!m_groups->contains(groupId)) {
+        return;
+    }
+
+    m_groups->published(groupId, id);
+    scheduleGroupFlush(m_groups->flushDelay(groupId));
+
+    // Signals for the summary are received by the owner it was published with
+    const QString owner(m_groups->owner(groupId));
+    if (id != 0 && m_ownerSignals == OwnerSignalsSupported
+            && !m_subscribedOwners.contains(owner.isEmpty() ? processName() : owner)) {
+        updateSubscriptions();
+    }
+}
+
+void NotificationConnectionManager::removeGroupMember(const QString &groupId, Notification *notification, bool withdrawn)
+{
+    m_groups->removeMember(groupId, notification, withdrawn);
+}
+
+void NotificationConnectionManager::scheduleGroupFlush(qint64 delay)
+{
+    if (delay < 0) {
+        return;
+    }
+    if (!m_groupTimer) {
+        m_groupTimer = new QTimer(this);
+        m_groupTimer->setSingleShot(true);
+        connect(m_groupTimer, SIGNAL(timeout()), this, SLOT(flushGroups()));
+    }
+    if (!m_groupTimer->isActive() || m_groupTimer->remainingTime() > delay) {
+        m_groupTimer->start(delay);
+    }
+}
+
+void NotificationConnectionManager::flushGroups()
+{
+    qint64 next = -1;
+    const QStringList due(m_groups->dueGroups(&next));
+
+    // Publishing may modify the groups, so they are looked up again for each update
+    for (const QString &groupId : due) {
+        publishGroup(groupId);
+    }
+
+    if (next >= 0) {
+        m_groupTimer->start(next);
+    }
+}
+
+void NotificationConnectionManager::publishGroup(const QString &groupId)
+{
+    NotificationData data;
+    QList<QPointer<Notification> > members;
+    if (!m_groups->takePending(groupId, &data, &members)) {
+        return;
+    }
+
+    QElapsedTimer sent;
+    sent.start();
+    QDBusPendingReply<uint> reply = notificationManager()->Notify(
+                data.appName(), data.replacesId(), data.appIcon(), data.summary(), data.body(),
+                encodeActions(data.actions()), data.hints(), data.expireTimeout());
+    reply.waitForFinished();
+    publishCompleted(sent.nsecsElapsed() / 1000, !reply.isError());
+    if (reply.isError()) {
+        if (!isServiceUnavailable(reply.error()) || !enqueueOffline(data, members.last())) {
+            qWarning() << "Unable to publish grouped notification:" << reply.error().message();
+        }
+        return;
+    }
+
+    const uint previousId = data.replacesId();
+    const uint id = reply.value();
+    m_groups->published(groupId, id);
+
+    if (m_listingCacheEnabled) {
+        data.setReplacesId(id);
+        notificationPublished(previousId, data);
+    }
+
+    // Each collapsed member is now represented by the summary
+    for (const QPointer<Notification> &member : members) {
+        if (member) {
+            member->setReplacesId(id);
+        }
+    }
+}
+
+NotificationConnectionManager::DuplicatePolicy NotificationConnectionManager::duplicatePolicy() const
+{
+    return m_duplicateFilter->policy();
+}
+
+void NotificationConnectionManager::setDuplicatePolicy(DuplicatePolicy policy)
+{
+    m_duplicateFilter->setPolicy(policy);
+}
+
+quint64 NotificationConnectionManager::skippedPublishes() const
+{
+    return m_duplicateFilter->skipped();
+}
+
+quint64 NotificationConnectionManager::refreshedPublishes() const
+{
+    return m_duplicateFilter->refreshed();
+}
+
+bool NotificationConnectionManager::filterDuplicate(NotificationData *data, QByteArray *digest)
+{
+    return m_duplicateFilter->filter(data, digest);
+}
+
+void NotificationConnectionManager::publishAcknowledged(uint id, const QByteArray &digest, const QVariantHash &hints)
+{
+    m_duplicateFilter->acknowledge(id, digest, hints);
+}
+
+int NotificationConnectionManager::progressUpdateInterval() const
+{
+    return m_progressUpdateInterval;
+}
+
+void NotificationConnectionManager::setProgressUpdateInterval(int milliseconds)
+{
+    m_progressUpdateInterval = qMax(0, milliseconds);
+}
+
+qreal NotificationConnectionManager::progressGranularity() const
+{
+    return m_progressGranularity;
+}
+
+void NotificationConnectionManager::setProgressGranularity(qreal granularity)
+{
+    m_progressGranularity = qMax<qreal>(0, granularity);
+}
+
+quint64 NotificationConnectionManager::droppedProgressUpdates() const
+{
+    return m_droppedProgressUpdates;
+}
+
+void NotificationConnectionManager::updateProgress(Notification *notification, uint id, const QVariant &progress)
+{
+    ProgressUpdate &update(m_progressUpdates[notification]);
+    update.notification = notification;
+    update.id = id;
+
+    if (!progress.isValid()) {
+        // A hint cannot be sent without a value; the reset progress is removed by publishing in full
+        if (update.pending) {
+            update.pending = false;
+            ++m_droppedProgressUpdates;
+        }
+        update.sentValue = QVariant();
+        notification->publish();
+        return;
+    }
+
+    // Changes too small to be seen are not sent, unless they complete the progress
+    const bool determinate = progress.toDouble() >= 0;
+    const bool sentDeterminate = update.sentValue.isValid() && update.sentValue.toDouble() >= 0;
+    if (determinate && sentDeterminate && progress.toDouble() < 1.0
+            && qAbs(progress.toDouble() - update.sentValue.toDouble()) < m_progressGranularity) {
+        if (update.pending) {
+            // The pending value is superseded by one that need not be sent
+            update.pending = false;
+            ++m_droppedProgressUpdates;
+        }
+        ++m_droppedProgressUpdates;
+        return;
+    }
+
+    if (update.pending) {
+        ++m_droppedProgressUpdates;
+    }
+    update.value = progress;
+    update.pending = true;
+    sendProgressUpdate(notification);
+}
+
+void NotificationConnectionManager::sendProgressUpdate(Notification *notification)
+{
+    QHash<Notification *, ProgressUpdate>::iterator it = m_progressUpdates.find(notification);
+    if (it == m_progressUpdates.end() || !it.value().pending || it.value().inFlight) {
+        // An outstanding update sends the latest value when it completes
+        return;
+    }
+
+    ProgressUpdate &update(it.value());
+    if (update.sent.isValid() && update.sent.elapsed() < m_progressUpdateInterval) {
+        if (!m_progressTimer) {
+            m_progressTimer = new QTimer(this);
+            m_progressTimer->setSingleShot(true);
+            connect(m_progressTimer, SIGNAL(timeout()), this, SLOT(flushProgressUpdates()));
+        }
+        const int remaining = m_progressUpdateInterval - static_cast<int>(update.sent.elapsed());
+        if (!m_progressTimer->isActive() || m_progressTimer->remainingTime() > remaining) {
+            m_progressTimer->start(remaining);
+        }
+        return;
+    }
+
+    update.pending = false;
+    update.sentValue = update.value;
+    update.sent.start();
+
+    if (m_progressUpdateUnsupported) {
+        // Without the extension, the whole notification must be published again
+        if (update.notification) {
+            update.notification->publish();
+        }
+        return;
+    }
+
+    QVariantHash hints;
+    hints.insert(HINT_PROGRESS, update.value);
+    update.inFlight = true;
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
+                notificationManager()->UpdateNotificationHints(update.id, hints), this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(progressUpdateFinished(QDBusPendingCallWatcher*)));
+    m_progressCalls.insert(watcher, notification);
+}
+
+void NotificationConnectionManager::progressUpdateFinished(QDBusPendingCallWatcher *watcher)
+{
+    Notification *notification = m_progressCalls.take(watcher);
+    watcher->deleteLater();
+
+    QHash<Notification *, ProgressUpdate>::iterator it = m_progressUpdates.find(notification);
+    if (it == m_progressUpdates.end()) {
+        return;
+    }
+
+    ProgressUpdate &update(it.value());
+    update.inFlight = false;
+    if (watcher->isError()) {
+        if (watcher->error().type() == QDBusError::UnknownMethod) {
+            // Older notification servers do not provide the update extension
+            m_progressUpdateUnsupported = true;
+            update.pending = true;
+            update.sent.invalidate();
+        } else {
+            qWarning() << "Unable to update notification progress:" << watcher->error().message();
+        }
+    }
+    sendProgressUpdate(notification);
+}
+
+void NotificationConnectionManager::flushProgressUpdates()
+{
+    // Sending may modify the set of updates, so they are looked up again for each
+    const QList<Notification *> notifications(m_progressUpdates.keys());
+    for (Notification *notification : notifications) {
+        sendProgressUpdate(notification);
+    }
+}
+
+bool NotificationConnectionManager::asynchronousPublishing() const
+{
+    return m_asynchronousPublishing;
+}
+
+void NotificationConnectionManager::setAsynchronousPublishing(bool asynchronous)
+{
+    m_asynchronousPublishing = asynchronous;
+}
+
+int NotificationConnectionManager::maxPublishesInFlight() const
+{
+    return m_publishScheduler->maxInFlight();
+}
+
+void NotificationConnectionManager::setMaxPublishesInFlight(int count)
+{
+    m_publishScheduler->setMaxInFlight(count);
+    dispatchPublishes();
+}
+
+int NotificationConnectionManager::reservedCriticalPublishes() const
+{
+    return m_publishScheduler->reservedCritical();
+}
+
+void NotificationConnectionManager::setReservedCriticalPublishes(int count)
+{
+    m_publishScheduler->setReservedCritical(count);
+    dispatchPublishes();
+}
+
+int NotificationConnectionManager::publishQueueDepth() const
+{
+    return m_publishScheduler->queueDepth();
+}
+
+int NotificationConnectionManager::peakPublishQueueDepth() const
+{
+    return m_publishScheduler->peakQueueDepth();
+}
+
+int NotificationConnectionManager::publishesInFlight() const
+{
+    return m_publishScheduler->inFlight();
+}
+
+quint64 NotificationConnectionManager::mergedPublishes() const
+{
+    return m_publishScheduler->merged();
+}
+
+qint64 NotificationConnectionManager::maxPublishWait() const
+{
+    return m_publishScheduler->maxWait();
+}
+
+qint64 NotificationConnectionManager::maxPublishWait(int urgency) const
+{
+    return m_publishScheduler->maxWait(urgency);
+}
+
+qint64 NotificationConnectionManager::averagePublishWait() const
+{
+    return m_publishScheduler->averageWait();
+}
+
+void NotificationConnectionManager::schedulePublish(const NotificationData &data, Notification *notification, const QByteArray &digest,
+                                                    NotificationQueue *queue)
+{
+    ScheduledPublish entry;
+    entry.data = data;
+    entry.notification = notification;
+    entry.digest = digest;
+    entry.queue = queue;
+    entry.urgency = data.hints().value(HINT_URGENCY).toInt();
+
+    const QPointer<NotificationQueue> supersededQueue(m_publishScheduler->schedule(entry));
+    if (supersededQueue) {
+        // The superseding update is sent in its place
+        supersededQueue->publishFinished(NotificationQueue::NotSent);
+    }
+
+    dispatchPublishes();
+}
+
+void NotificationConnectionManager::cancelScheduledPublish(Notification *notification)
+{
+    QList<ScheduledPublish> queued;
+    QList<ScheduledPublish> held;
+    m_publishScheduler->cancel(notification, &queued, &held);
+
+    // A summary that will not be published no longer holds back its group; a held update
+    // is not the first publication of its summary, which is still in flight
+    for (const ScheduledPublish &entry : queued) {
+        const QString groupId(entry.data.hints().value(HINT_GROUP_ID).toString());
+        if (!groupId.isEmpty()) {
+            groupPublished(groupId, 0);
+        }
+    }
+    for (const ScheduledPublish &entry : queued + held) {
+        if (entry.queue) {
+            entry.queue->publishFinished(NotificationQueue::NotSent);
+        }
+    }
+}
+
+void NotificationConnectionManager::dispatchPublishes()
+{
+    NotificationManagerProxy *proxy = nullptr;
+    ScheduledPublish entry;
+    while (m_publishScheduler->takeNext(&entry)) {
+        if (!proxy) {
+            proxy = notificationManager();
+        }
+
+        entry.sent.start();
+        const NotificationData &data(entry.data);
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
+                    proxy->Notify(data.appName(), data.replacesId(), data.appIcon(), data.summary(), data.body(),
+                                  encodeActions(data.actions()), data.hints(), data.expireTimeout()), this);
+        connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(scheduledPublishFinished(QDBusPendingCallWatcher*)));
+        m_publishScheduler->sent(watcher, entry);
+    }
+}
+
+void NotificationConnectionManager::scheduledPublishFinished(QDBusPendingCallWatcher *watcher)
+{
+    watcher->deleteLater();
+
+    QDBusPendingReply<uint> reply(*watcher);
+    const ScheduledPublish entry(m_publishScheduler->finished(watcher, reply.isError() ? 0 : reply.value()));
+    publishCompleted(entry.sent.nsecsElapsed() / 1000, !reply.isError());
+
+    const QString groupId(entry.data.hints().value(HINT_GROUP_ID).toString());
+    if (entry.cancelled) {
+        // The notification was closed before the server replied. An existing ID was closed
+        // then, but a notification created by this publication must be closed now
+        const uint id = reply.isError() ? 0 : reply.value();
+        if (!groupId.isEmpty()) {
+            groupPublished(groupId, id);
+        }
+        if (id != 0 && id != entry.data.replacesId()) {
+            notificationManager()->CloseNotification(id);
+            notificationRemoved(id);
+        }
+        if (entry.queue) {
+            entry.queue->publishFinished(NotificationQueue::NotSent);
+        }
+    } else if (reply.isError()) {
+        const bool queued = isServiceUnavailable(reply.error()) && enqueueOffline(entry.data, entry.notification);
+        if (!queued) {
+            qWarning() << "Unable to publish notification:" << reply.error().message();
+        }
+        if (!groupId.isEmpty()) {
+            groupPublished(groupId, 0);
+        }
+        if (entry.queue) {
+            entry.queue->publishFinished(queued ? NotificationQueue::NotSent : NotificationQueue::Failed);
+        }
+    } else {
+        const uint id = reply.value();
+        if (entry.notification && entry.notification->replacesId() == entry.data.replacesId()) {
+            entry.notification->setReplacesId(id);
+        }
+        if (!entry.digest.isEmpty() && id != 0) {
+            publishAcknowledged(id, entry.digest, entry.data.hints());
+        }
+        if (!groupId.isEmpty()) {
+            groupPublished(groupId, id);
+        }
+        if (id != 0 && m_listingCacheEnabled) {
+            NotificationData data(entry.data);
+            data.setReplacesId(id);
+            notificationPublished(entry.data.replacesId(), data);
+        }
+        if (entry.queue) {
+            entry.queue->publishFinished(NotificationQueue::Published);
+        }
+    }
+
+    dispatchPublishes();
+}
+
+void NotificationConnectionManager::closeAll(const QString &owner)
+{
+    startCloseAll(OwnerListing, owner);
+}
+
+void NotificationConnectionManager::closeAllByCategory(const QString &category)
+{
+    startCloseAll(CategoryListing, category);
+}
+
+void NotificationConnectionManager::startCloseAll(ListingKind kind, const QString &argument)
+{
+    if (m_closeAllUnsupported) {
+        closeListed(kind, argument);
+        return;
+    }
+
+    CloseRequest request;
+    request.kind = kind;
+    request.argument = argument;
+
+    NotificationManagerProxy *proxy = notificationManager();
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
+                kind == OwnerListing ? proxy->CloseNotifications(argument) : proxy->CloseNotificationsByCategory(argument), this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(closeAllFinished(QDBusPendingCallWatcher*)));
+    m_closeCalls.insert(watcher, request);
+}
+
+void NotificationConnectionManager::closeAllFinished(QDBusPendingCallWatcher *watcher)
+{
+    const CloseRequest request(m_closeCalls.take(watcher));
+    watcher->deleteLater();
+
+    if (!watcher->isError()) {
+        // Which notifications were closed is not reported, so no listing can be trusted
+        clearListingCache();
+
+        // Discard the state of the matching notifications we have published
+        const bool byOwner = (request.kind == OwnerListing);
+        QList<uint> closed(byOwner ? m_duplicateFilter->idsWithOwner(request.argument)
+                                   : m_duplicateFilter->idsWithCategory(request.argument));
+        closed.append(byOwner ? m_groups->idsWithOwner(request.argument)
+                              : m_groups->idsWithCategory(request.argument));
+        for (uint id : closed) {
+            notificationRemoved(id);
+        }
+        return;
+    }
+
+    if (watcher->error().type() == QDBusError::UnknownMethod) {
+        // Older notification servers do not provide the bulk close extension
+        m_closeAllUnsupported = true;
+        closeListed(request.kind, request.argument);
+    } else {
+        qWarning() << "Unable to close notifications:" << watcher->error().message();
+    }
+}
+
+void NotificationConnectionManager::closeListed(ListingKind kind, const QString &argument)
+{
+    CloseRequest request;
+    request.kind = kind;
+    request.argument = argument;
+
+    // Only the IDs are needed, so the listing is decoded as a table
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(requestListing(kind, argument), this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(closeListingReceived(QDBusPendingCallWatcher*)));
+    m_closeCalls.insert(watcher, request);
+}
+
+void NotificationConnectionManager::closeListingReceived(QDBusPendingCallWatcher *watcher)
+{
+    m_closeCalls.remove(watcher);
+    watcher->deleteLater();
+
+    QDBusPendingReply<NotificationTable> reply(*watcher);
+    if (reply.isError()) {
+        qWarning() << "Unable to list notifications to close:" << reply.error().message();
+        return;
+    }
+
+    // The calls are sent together without waiting for their replies
+    NotificationManagerProxy *proxy = notificationManager();
+    const NotificationTable table(reply.value());
+    for (uint id : table.ids()) {
+        proxy->CloseNotification(id);
+        notificationRemoved(id);
+    }
+}
+
+QFuture<QList<QObject *> > NotificationConnectionManager::notificationsAsync(const QString &owner)
+{
+    return fetchAsync(OwnerListing, owner);
+}
+
+QFuture<QList<QObject *> > NotificationConnectionManager::notificationsByCategoryAsync(const QString &category)
+{
+    return fetchAsync(CategoryListing, category);
+}
+
+QDBusPendingCall NotificationConnectionManager::requestListing(ListingKind kind, const QString &argument)
+{
+    // The reply may be decoded as a list of NotificationData or as a NotificationTable
+    NotificationManagerProxy *proxy = notificationManager();
+    return kind == OwnerListing ? QDBusPendingCall(proxy->GetNotifications(argument))
+                                : QDBusPendingCall(proxy->GetNotificationsByCategory(argument));
+}
+
+QFuture<QList<QObject *> > NotificationConnectionManager::fetchAsync(ListingKind kind, const QString &argument)
+{
+    NotificationListingCache *listings = (kind == OwnerListing ? m_ownerListings.data() : m_categoryListings.data());
+
+    AsyncListing listing;
+    listing.listings = listings;
+    listing.argument = argument;
+    listing.result.reportStarted();
+    const QFuture<QList<QObject *> > future(listing.result.future());
+
+    if (m_listingCacheEnabled) {
+        if (const QList<NotificationData> *cached = listings->find(argument)) {
+            listing.result.reportResult(createNotifications(*cached));
+            listing.result.reportFinished();
+            return future;
+        }
+    }
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(requestListing(kind, argument), this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(asyncListingReceived(QDBusPendingCallWatcher*)));
+    m_listingCalls.insert(watcher, listing);
+    return future;
+}
+
+void NotificationConnectionManager::asyncListingReceived(QDBusPendingCallWatcher *watcher)
+{
+    AsyncListing listing(m_listingCalls.take(watcher));
+    watcher->deleteLater();
+
+    if (watcher->isError()) {
+        listing.result.reportResult(QList<QObject *>());
+        listing.result.reportFinished();
+        return;
+    }
+
+    // The objects are created here once decoding is complete, as they are registered with us
+    QFutureInterface<QList<NotificationData> > decoded;
+    decoded.reportStarted();
+    QFutureWatcher<QList<NotificationData> > *decodeWatcher = new QFutureWatcher<QList<NotificationData> >(this);
+    connect(decodeWatcher, SIGNAL(finished()), this, SLOT(asyncListingDecoded()));
+    decodeWatcher->setFuture(decoded.future());
+    m_listingDecodes.insert(decodeWatcher, listing);
+
+    QThreadPool::globalInstance()->start(new ListingDecoder(watcher->reply(), decoded));
+}
+
+void NotificationConnectionManager::asyncListingDecoded()
+{
+    QFutureWatcher<QList<NotificationData> > *decodeWatcher = static_cast<QFutureWatcher<QList<NotificationData> > *>(sender());
+    AsyncListing listing(m_listingDecodes.take(decodeWatcher));
+    decodeWatcher->deleteLater();
+
+    const QList<NotificationData> notifications(decodeWatcher->result());
+    if (m_listingCacheEnabled) {
+        listing.listings->insert(listing.argument, notifications);
+        updateSubscriptions();
+    }
+    listing.result.reportResult(createNotifications(notifications));
+    listing.result.reportFinished();
+}
+
+QList<QObject *> NotificationConnectionManager::createNotifications(const QList<NotificationData> &notifications)
+{
+    QList<QObject *> objects;
+    objects.reserve(notifications.count());
+    for (const NotificationData &notification : notifications) {
+        objects.append(Notification::createNotification(notification, this, this));
+    }
+    return objects;
+}
+
+NotificationTable NotificationConnectionManager::notificationTable(const QString &owner)
+{
+    return fetchTable(OwnerListing, owner);
+}
+
+NotificationTable NotificationConnectionManager::notificationTableByCategory(const QString &category)
+{
+    return fetchTable(CategoryListing, category);
+}
+
+NotificationTable NotificationConnectionManager::fetchTable(ListingKind kind, const QString &argument)
+{
+    NotificationListingCache *listings = (kind == OwnerListing ? m_ownerListings.data() : m_categoryListings.data());
+    NotificationTable table;
+
+    if (m_listingCacheEnabled) {
+        // A table does not hold enough to populate the cache, so this is not a miss
+        if (const QList<NotificationData> *cached = listings->find(argument, false)) {
+            for (const NotificationData &data : *cached) {
+                table.d->append(data);
+            }
+            return table;
+        }
+    }
+
+    // The reply is decoded straight into the table, without constructing NotificationData
+    QDBusPendingReply<NotificationTable> reply = requestListing(kind, argument);
+    reply.waitForFinished();
+    if (!reply.isError()) {
+        table = reply.value();
+    }
+    return table;
+}
+
+void NotificationConnectionManager::notificationPublished(uint previousId, const NotificationData &data)
+{
+    if (!m_listingCacheEnabled) {
+        return;
+    }
+
+    if (previousId != 0 && previousId != data.replacesId()) {
+        notificationRemoved(previousId);
+    }
+
+    m_ownerListings->published(data.hints().value(HINT_OWNER).toString(), data);
+    m_categoryListings->published(data.hints().value(HINT_CATEGORY).toString(), data);
+}
+
+void NotificationConnectionManager::notificationRemoved(uint id)
+{
+    m_duplicateFilter->remove(id);
+
+    if (m_groups->summaryRemoved(id)) {
+        updateSubscriptions();
+    }
+
+    if (!m_listingCacheEnabled) {
+        return;
+    }
+
+    m_ownerListings->removed(id);
+    m_categoryListings->removed(id);
+}
+
+void NotificationConnectionManager::notificationClosed(uint id)
+{
+    notificationRemoved(id);
+}
+
+bool NotificationConnectionManager::statisticsExported() const
+{
+    return m_statisticsExported;
+}
+
+void NotificationConnectionManager::setStatisticsExported(bool exported)
+{
+    if (m_statisticsExported == exported) {
+        return;
+    }
+
+    QDBusConnection bus(dBusConnection ? *dBusConnection : QDBusConnection::sessionBus());
+    if (exported) {
+        if (!findChild<NotificationStatisticsAdaptor *>(QString(), Qt::FindDirectChildrenOnly)) {
+            new NotificationStatisticsAdaptor(this);
+        }
+        if (!bus.registerObject(QStringLiteral(DBUS_STATISTICS_PATH), this, QDBusConnection::ExportAdaptors)) {
+            qWarning() << "Unable to export notification statistics:" << bus.lastError().message();
+            return;
+        }
+    } else {
+        bus.unregisterObject(QStringLiteral(DBUS_STATISTICS_PATH));
+    }
+    m_publishStatistics->setSampling(exported);
+    m_statisticsExported = exported;
+}
+
+void NotificationConnectionManager::publishCompleted(qint64 latency, bool published)
+{
+    m_publishStatistics->record(latency, published);
+}
+
+QVariantMap NotificationConnectionManager::statistics() const
+{
+    QVariantMap rv;
+    rv.insert(QStringLiteral("publishesInFlight"), publishesInFlight());
+    rv.insert(QStringLiteral("publishQueueDepth"), publishQueueDepth());
+    rv.insert(QStringLiteral("peakPublishQueueDepth"), peakPublishQueueDepth());
+    rv.insert(QStringLiteral("mergedPublishes"), mergedPublishes());
+    rv.insert(QStringLiteral("skippedPublishes"), skippedPublishes());
+    rv.insert(QStringLiteral("refreshedPublishes"), refreshedPublishes());
+    rv.insert(QStringLiteral("collapsedGroupUpdates"), m_groups->collapsedUpdates());
+    rv.insert(QStringLiteral("droppedProgressUpdates"), m_droppedProgressUpdates);
+    rv.insert(QStringLiteral("progressUpdatesInFlight"), m_progressCalls.count());
+    rv.insert(QStringLiteral("offlineQueueSize"), m_offlineQueue->count());
+    rv.insert(QStringLiteral("trackedNotifications"), m_notifications.count());
+    rv.insert(QStringLiteral("maxPublishWait"), maxPublishWait());
+    rv.insert(QStringLiteral("averagePublishWait"), averagePublishWait());
+
+    rv.insert(QStringLiteral("cachedListings"), m_ownerListings->count() + m_categoryListings->count());
+    rv.insert(QStringLiteral("cachedListingNotifications"),
+              m_ownerListings->notificationCount() + m_categoryListings->notificationCount());
+    rv.insert(QStringLiteral("listingCacheHits"), listingCacheHits());
+    rv.insert(QStringLiteral("listingCacheMisses"), listingCacheMisses());
+
+    m_publishStatistics->insertInto(&rv);
+    return rv;
+}
+
+NotificationStatisticsAdaptor::NotificationStatisticsAdaptor(NotificationConnectionManager *manager)
+    : QDBusAbstractAdaptor(manager)
+    , m_manager(manager)
+{
+}
+
+QVariantMap NotificationStatisticsAdaptor::GetStatistics() const
+{
+    return m_manager->statistics();
+}
+
+bool NotificationConnectionManager::useDBusConnection(const QDBusConnection &conn)
+{
+    if (connMgr()->proxy.isNull()) {
+        if (conn.isConnected()) {
+            connMgr()->dBusConnection.reset(new QDBusConnection(conn));
+            return true;
+        } else {
+            qWarning() << "Supplied DBus connection is not connected.";
+        }
+    } else {
+        qWarning() << "Cannot override DBus connection - notifications already exist.";
+    }
+    return false;
+}
+
+NotificationConnectionManager *NotificationConnectionManager::instance()
+{
+    return connMgr();
+}
+
+NotificationConnectionManager *NotificationConnectionManager::instance(const QDBusConnection &bus)
+{
+    NotificationConnectionManager *defaultManager = connMgr();
+    const QString name(bus.name());
+    if (defaultManager->dBusConnection
+            ? defaultManager->dBusConnection->name() == name
+            : name == QDBusConnection::sessionBus().name()) {
+        return defaultManager;
+    }
+
+    QSharedPointer<NotificationConnectionManager> &manager = (*connMgrs())[name];
+    if (manager.isNull()) {
+        manager.reset(new NotificationConnectionManager);
+        manager->dBusConnection.reset(new QDBusConnection(bus));
+    }
+    return manager.data();
+}
+
+/*!
+    \class NotificationTable
+    \brief A columnar listing of existing notifications
+    \inmodule NemoNotifications
+
+    NotificationTable holds a few well-known properties of many notifications,
+    without constructing a \c Notification object for each of them. Each property
+    is stored in a contiguous array indexed by row; the category, owner and
+    application name are stored as indices into a dictionary of distinct values.
+
+    The table is implicitly shared.
+ */
+
+NotificationTable::NotificationTable()
+    : d(new NotificationTablePrivate)
+{
+}
+
+NotificationTable::NotificationTable(const NotificationTable &other)
+    : d(other.d)
+{
+}
+
+NotificationTable::~NotificationTable()
+{
+}
+
+NotificationTable &NotificationTable::operator=(const NotificationTable &other)
+{
+    d = other.d;
+    return *this;
+}
+
+/*!
+    Returns a table of existing notifications whose 'x-nemo-owner' hint value
+    matches \a owner.
+ */
+NotificationTable NotificationTable::notifications(const QString &owner)
+{
+    return connMgr()->notificationTable(owner);
+}
+
+/*!
+    Returns a table of existing notifications whose 'x-nemo-owner' hint value
+    matches \a owner, as reported by the notification server reached over \a bus.
+ */
+NotificationTable NotificationTable::notifications(const QString &owner, const QDBusConnection &bus)
+{
+    return NotificationConnectionManager::instance(bus)->notificationTable(owner);
+}
+
+/*!
+    Returns a table of existing notifications whose 'category' hint value
+    matches \a category. This requires privileged access rights from the caller.
+ */
+NotificationTable NotificationTable::notificationsByCategory(const QString &category)
+{
+    return connMgr()->notificationTableByCategory(category);
+}
+
+/*!
+    Returns a table of existing notifications whose 'category' hint value
+    matches \a category, as reported by the notification server reached over \a bus.
+    This requires privileged access rights from the caller.
+ */
+NotificationTable NotificationTable::notificationsByCategory(const QString &category, const QDBusConnection &bus)
+{
+    return NotificationConnectionManager::instance(bus)->notificationTableByCategory(category);
+}
+
+/*!
+    Returns the number of rows in the table.
+ */
+int NotificationTable::count() const
+{
+    return d->ids.count();
+}
+
+/*!
+    Returns true if the table has no rows.
+ */
+bool NotificationTable::isEmpty() const
+{
+    return d->ids.isEmpty();
+}
+
+/*!
+    Returns the notification ID of each row.
+ */
+const QVector<uint> &NotificationTable::ids() const
+{
+    return d->ids;
+}
+
+/*!
+    Returns the urgency of each row, as a \c Notification::Urgency value.
+ */
+const QVector<int> &NotificationTable::urgencies() const
+{
+    return d->urgencies;
+}
+
+/*!
+    Returns the timestamp of each row in milliseconds since the epoch, or zero
+    if the notification has no timestamp.
+ */
+const QVector<qint64> &NotificationTable::timestamps() const
+{
+    return d->timestamps;
+}
+
+/*!
+    Returns the item count of each row.
+ */
+const QVector<int> &NotificationTable::itemCounts() const
+{
+    return d->itemCounts;
+}
+
+/*!
+    Returns the index into categories() of each row.
+ */
+const QVector<int> &NotificationTable::categoryIndices() const
+{
+    return d->categoryIndices;
+}
+
+/*!
+    Returns the distinct categories of the rows in the table.
+ */
+const QStringList &NotificationTable::categories() const
+{
+    return d->categories;
+}
+
+/*!
+    Returns the category of \a row.
+ */
+QString NotificationTable::category(int row) const
+{
+    return d->categories.at(d->categoryIndices.at(row));
+}
+
+/*!
+    Returns the index into owners() of each row.
+ */
+const QVector<int> &NotificationTable::ownerIndices() const
+{
+    return d->ownerIndices;
+}
+
+/*!
+    Returns the distinct owners of the rows in the table.
+ */
+const QStringList &NotificationTable::owners() const
+{
+    return d->owners;
+}
+
+/*!
+    Returns the owner of \a row.
+ */
+QString NotificationTable::owner(int row) const
+{
+    return d->owners.at(d->ownerIndices.at(row));
+}
+
+/*!
+    Returns the index into appNames() of each row.
+ */
+const QVector<int> &NotificationTable::appNameIndices() const
+{
+    return d->appNameIndices;
+}
+
+/*!
+    Returns the distinct application names of the rows in the table.
+ */
+const QStringList &NotificationTable::appNames() const
+{
+    return d->appNames;
+}
+
+/*!
+    Returns the application name of \a row.
+ */
+QString NotificationTable::appName(int row) const
+{
+    return d->appNames.at(d->appNameIndices.at(row));
+}
+
+/*!
+    Returns the rows of the table sorted by timestamp in \a order.
+    Rows with equal timestamps retain their relative order.
+ */
+QVector<int> NotificationTable::sortedByTimestamp(Qt::SortOrder order) const
+{
+    QVector<int> rows(count());
+    for (int i = 0; i < rows.count(); ++i) {
+        rows[i] = i;
+    }
+
+    const qint64 *timestamps = d->timestamps.constData();
+    if (order == Qt::AscendingOrder) {
+        std::stable_sort(rows.begin(), rows.end(), [timestamps](int lhs, int rhs) {
+            return timestamps[lhs] < timestamps[rhs];
+        });
+    } else {
+        std::stable_sort(rows.begin(), rows.end(), [timestamps](int lhs, int rhs) {
+            return timestamps[lhs] > timestamps[rhs];
+        });
+    }
+    return rows;
+}
+
+/*!
+    Returns the rows of the table grouped by category. The groups are
+    ordered as categories(), and each lists its rows in table order.
+ */
+QVector<QVector<int> > NotificationTable::groupedByCategory() const
+{
+    QVector<int> sizes(d->categories.count(), 0);
+    for (int index : d->categoryIndices) {
+        ++sizes[index];
+    }
+
+    QVector<QVector<int> > groups(d->categories.count());
+    for (int i = 0; i < groups.count(); ++i) {
+        groups[i].reserve(sizes.at(i));
+    }
+    for (int row = 0; row < d->categoryIndices.count(); ++row) {
+        groups[d->categoryIndices.at(row)].append(row);
+    }
+    return groups;
 }
 
 #include "moc_notification.cpp"
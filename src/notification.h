@@ -39,13 +39,17 @@
 #include <QString>
 #include <QStringList>
 #include <QDateTime>
+#include <QFuture>
 #include <QVariant>
 #include <QVariantList>
 
-struct NotificationData;
+class NotificationData;
 
+class QDBusConnection;
+class NotificationConnectionManager;
 class NotificationManagerProxy;
 class NotificationPrivate;
+class NotificationQueue;
 
 class NEMO_QML_PLUGIN_NOTIFICATIONS_EXPORT Notification : public QObject
 {
@@ -71,6 +75,7 @@ class NEMO_QML_PLUGIN_NOTIFICATIONS_EXPORT Notification : public QObject
     Q_PROPERTY(bool isTransient READ isTransient WRITE setIsTransient NOTIFY isTransientChanged)
     Q_PROPERTY(bool resident READ resident WRITE setResident NOTIFY residentChanged)
     Q_PROPERTY(QVariant progress READ progress WRITE setProgress RESET resetProgress NOTIFY progressChanged)
+    Q_PROPERTY(QString groupId READ groupId WRITE setGroupId NOTIFY groupIdChanged)
     // deprecated properties
     Q_PROPERTY(QString remoteDBusCallServiceName READ remoteDBusCallServiceName WRITE setRemoteDBusCallServiceName NOTIFY remoteDBusCallChanged)
     Q_PROPERTY(QString remoteDBusCallObjectPath READ remoteDBusCallObjectPath WRITE setRemoteDBusCallObjectPath NOTIFY remoteDBusCallChanged)
@@ -180,10 +185,16 @@ public:
     QVariant progress() const;
     void setProgress(const QVariant &value);
     void resetProgress();
+    Q_INVOKABLE void updateProgress(const QVariant &value);
+
+    QString groupId() const;
+    void setGroupId(const QString &groupId);
 
     QVariant hintValue(const QString &hint) const;
     void setHintValue(const QString &hint, const QVariant &value);
 
+    bool setDBusConnection(const QDBusConnection &bus);
+
     Q_INVOKABLE void publish();
     Q_INVOKABLE void close();
 
@@ -191,6 +202,21 @@ public:
     Q_INVOKABLE static QList<QObject*> notifications(const QString &owner);
     Q_INVOKABLE static QList<QObject*> notificationsByCategory(const QString &category);
 
+    Q_INVOKABLE static void closeAll();
+    Q_INVOKABLE static void closeAll(const QString &owner);
+    Q_INVOKABLE static void closeAllByCategory(const QString &category);
+
+    static QList<QObject*> notifications(const QString &owner, const QDBusConnection &bus);
+    static QList<QObject*> notificationsByCategory(const QString &category, const QDBusConnection &bus);
+
+    static void closeAll(const QString &owner, const QDBusConnection &bus);
+    static void closeAllByCategory(const QString &category, const QDBusConnection &bus);
+
+    static QFuture<QList<QObject*> > notificationsAsync(const QString &owner);
+    static QFuture<QList<QObject*> > notificationsAsync(const QString &owner, const QDBusConnection &bus);
+    static QFuture<QList<QObject*> > notificationsByCategoryAsync(const QString &category);
+    static QFuture<QList<QObject*> > notificationsByCategoryAsync(const QString &category, const QDBusConnection &bus);
+
     Q_INVOKABLE static QVariant remoteAction(const QString &name, const QString &displayName,
                                              const QString &service = QString(), const QString &path = QString(), const QString &iface = QString(),
                                              const QString &method = QString(), const QVariantList &arguments = QVariantList());
@@ -225,6 +251,7 @@ signals:
     void isTransientChanged();
     void residentChanged();
     void progressChanged();
+    void groupIdChanged();
 
 private slots:
     void checkActionInvoked(uint id, QString actionKey);
@@ -232,12 +259,19 @@ private slots:
     void checkInputTextSet(uint id, const QString &inputText);
 
 private:
+    friend class NotificationConnectionManager;
+    friend class NotificationQueue;
+
     NotificationPrivate * const d_ptr;
     Q_DECLARE_PRIVATE(Notification)
 
-    Notification(const NotificationData &data, QObject *parent = 0);
+    Notification(const NotificationData &data, NotificationConnectionManager *connectionManager, QObject *parent = 0);
+
+    bool publish(NotificationQueue *queue);
 
-    static Notification *createNotification(const NotificationData &data, QObject *parent = 0);
+    static Notification *createNotification(const NotificationData &data, NotificationConnectionManager *connectionManager, QObject *parent = 0);
+    static QList<QObject*> notifications(NotificationConnectionManager *connectionManager, const QString &owner);
+    static QList<QObject*> notificationsByCategory(NotificationConnectionManager *connectionManager, const QString &category);
 };
 
 #endif // NOTIFICATION_H
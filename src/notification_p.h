@@ -35,42 +35,394 @@
 
 #include <notificationexport.h>
 
+#include <QObject>
 #include <QStringList>
 #include <QDateTime>
 #include <QVariantHash>
+#include <QVariantMap>
+#include <QVector>
+#include <QDBusAbstractAdaptor>
 #include <QDBusArgument>
+#include <QScopedPointer>
 #include <QSharedPointer>
+#include <QSharedDataPointer>
+#include <QPointer>
+#include <QElapsedTimer>
+#include <QFutureInterface>
+#include <QSet>
 
-struct NotificationData
+class NotificationDataPrivate;
+
+// Implicitly shared; copies share their content until one of them is modified
+class NEMO_QML_PLUGIN_NOTIFICATIONS_EXPORT NotificationData
 {
+public:
     struct ActionInfo {
         QString name;
         QString displayName;
     };
 
-    QString appName;
-    quint32 replacesId = 0;
-    QString appIcon;
-    QString summary;
-    QString body;
-    QList<ActionInfo> actions;
-    QVariantHash hints;
-    qint32 expireTimeout = -1;
-    QString inputText;
+    NotificationData();
+    NotificationData(const NotificationData &other);
+    ~NotificationData();
+
+    NotificationData &operator=(const NotificationData &other);
+
+    QString appName() const;
+    void setAppName(const QString &appName);
+
+    quint32 replacesId() const;
+    void setReplacesId(quint32 id);
+
+    QString appIcon() const;
+    void setAppIcon(const QString &appIcon);
+
+    QString summary() const;
+    void setSummary(const QString &summary);
+
+    QString body() const;
+    void setBody(const QString &body);
+
+    const QList<ActionInfo> &actions() const;
+    void setActions(const QList<ActionInfo> &actions);
+
+    const QVariantHash &hints() const;
+    void setHints(const QVariantHash &hints);
+    void setHint(const QString &hint, const QVariant &value);
+    void removeHint(const QString &hint);
+
+    qint32 expireTimeout() const;
+    void setExpireTimeout(qint32 milliseconds);
+
+    QString inputText() const;
+    void setInputText(const QString &inputText);
+
+private:
+    QSharedDataPointer<NotificationDataPrivate> d;
 };
 
+class QDBusError;
+class QDBusPendingCallWatcher;
+class QDBusServiceWatcher;
+class QTimer;
+class Notification;
+class NotificationDuplicateFilter;
+class NotificationGroups;
+class NotificationListingCache;
 class NotificationManagerProxy;
+class NotificationOfflineQueue;
+class NotificationPublishScheduler;
+class NotificationPublishStatistics;
+class NotificationQueue;
+class NotificationTable;
+
+// A notification waiting to be published, and the time it was sent once it is
+struct QueuedNotification {
+    NotificationData data;
+    QPointer<Notification> notification;
+    QElapsedTimer sent;
+};
+
+class NEMO_QML_PLUGIN_NOTIFICATIONS_EXPORT NotificationConnectionManager : public QObject
+{
+    Q_OBJECT
 
-class NEMO_QML_PLUGIN_NOTIFICATIONS_EXPORT NotificationConnectionManager {
 public:
+    enum DuplicatePolicy { PublishDuplicates, SkipDuplicates, RefreshDuplicateTimestamp };
+
+    NotificationConnectionManager();
+    ~NotificationConnectionManager();
+
     QSharedPointer<NotificationManagerProxy> proxy;
     QSharedPointer<QDBusConnection> dBusConnection;
+
+    // Creates the proxy on first use, and again whenever the notification service is restarted
+    NotificationManagerProxy *notificationManager();
+
+    // Signals are delivered only to the notifications having the relevant ID
+    void notificationIdChanged(Notification *notification, uint previousId, uint id);
+    // The owners whose signals are received, if the server emits signals by owner; otherwise
+    // empty, and the signals for every owner are received
+    QStringList subscribedOwners() const;
+
+    // The IDs of existing notifications are cleared when the notification service stops. Resident
+    // notifications are then republished in batches of replayBatchSize, up to replayLimit
+    // notifications, and adopt the IDs assigned by the new instance of the service
+    bool replayResidentNotifications() const;
+    void setReplayResidentNotifications(bool replay);
+    int replayBatchSize() const;
+    void setReplayBatchSize(int size);
+    int replayLimit() const;
+    void setReplayLimit(int limit);
+
+    int lastReplayCount() const;
+    qint64 lastReplayDuration() const;
+
+    // Notifications published while the notification service is not running are queued, up
+    // to offlineQueueLimit entries, and published once it appears. A limit of zero disables
+    // the queue. If a queue file is set, pending entries are saved to it whenever the queue
+    // changes, and all of the entries it holds are restored when it is set
+    int offlineQueueLimit() const;
+    void setOfflineQueueLimit(int limit);
+    QString offlineQueueFile() const;
+    void setOfflineQueueFile(const QString &path);
+    int offlineQueueSize() const;
+
+    bool enqueueOffline(const NotificationData &data, Notification *notification);
+    void cancelOffline(Notification *notification);
+
+    // Listings by owner and category can be answered from a local copy, which is filled by the first
+    // query and then maintained from our own publications and the NotificationClosed signal. Changes
+    // made by other processes are not observed, so it suits processes that own their notifications
+    bool listingCacheEnabled() const;
+    void setListingCacheEnabled(bool enabled);
+    quint64 listingCacheHits() const;
+    quint64 listingCacheMisses() const;
+    void clearListingCache();
+
+    QList<NotificationData> notifications(const QString &owner);
+    QList<NotificationData> notificationsByCategory(const QString &category);
+    // Notifications with a group ID are bundled into one summary notification per group, whose
+    // item count accumulates those of its members. Members published within groupingWindow
+    // milliseconds of the last summary update are collapsed into a single deferred update
+    int groupingWindow() const;
+    void setGroupingWindow(int milliseconds);
+    quint64 collapsedGroupUpdates() const;
+
+    bool bundleGrouped(const QString &groupId, NotificationData *data, Notification *notification);
+    void groupPublished(const QString &groupId, uint id);
+    // A member that is closed or moved to another group withdraws its item count from the summary;
+    // a destroyed member leaves its count in place, since its items are still represented there
+    void removeGroupMember(const QString &groupId, Notification *notification, bool withdrawn);
+
+    // A publication whose content matches the last acknowledged publication with the same ID
+    // is sent anyway, skipped, or sent with a refreshed timestamp. filterDuplicate() returns
+    // true if the publication should be skipped, and otherwise provides the digest to be
+    // acknowledged once it is published
+    DuplicatePolicy duplicatePolicy() const;
+    void setDuplicatePolicy(DuplicatePolicy policy);
+    quint64 skippedPublishes() const;
+    quint64 refreshedPublishes() const;
+
+    bool filterDuplicate(NotificationData *data, QByteArray *digest);
+    void publishAcknowledged(uint id, const QByteArray &digest, const QVariantHash &hints);
+
+    // Closes every notification with the given owner or category, without waiting for the
+    // notification server. A single request is sent if the server supports it; otherwise the
+    // matching IDs are listed and closed by concurrent CloseNotification calls
+    void closeAll(const QString &owner);
+    void closeAllByCategory(const QString &category);
+
+    // With asynchronous publishing, publish() queues the notification rather than waiting for the
+    // notification server. Up to maxPublishesInFlight Notify calls are outstanding at once; queued
+    // updates are sent in order of urgency, and a queued update to the same notification is replaced.
+    // reservedCriticalPublishes of the calls in flight are available only to critical notifications
+    bool asynchronousPublishing() const;
+    void setAsynchronousPublishing(bool asynchronous);
+    int maxPublishesInFlight() const;
+    void setMaxPublishesInFlight(int count);
+    int reservedCriticalPublishes() const;
+    void setReservedCriticalPublishes(int count);
+
+    int publishQueueDepth() const;
+    int peakPublishQueueDepth() const;
+    int publishesInFlight() const;
+    quint64 mergedPublishes() const;
+    qint64 maxPublishWait() const;
+    qint64 maxPublishWait(int urgency) const;
+    qint64 averagePublishWait() const;
+
+    void schedulePublish(const NotificationData &data, Notification *notification, const QByteArray &digest,
+                         NotificationQueue *queue = nullptr);
+    void cancelScheduledPublish(Notification *notification);
+
+    // Progress updates for published notifications send only the progress hint, at most once per
+    // progressUpdateInterval milliseconds and only for changes of at least progressGranularity.
+    // While an update is outstanding, later values replace each other and only the latest is sent
+    int progressUpdateInterval() const;
+    void setProgressUpdateInterval(int milliseconds);
+    qreal progressGranularity() const;
+    void setProgressGranularity(qreal granularity);
+    quint64 droppedProgressUpdates() const;
+
+    void updateProgress(Notification *notification, uint id, const QVariant &progress);
+
+    // Counters, queue depths and publish latency percentiles can be exported on our connection, for
+    // inspection by other processes. Latencies are sampled only while the statistics are exported;
+    // the percentiles are computed from the most recent samples when the statistics are requested
+    bool statisticsExported() const;
+    void setStatisticsExported(bool exported);
+    QVariantMap statistics() const;
+
+    void publishCompleted(qint64 latency, bool published);
+
+    // Listings whose replies are decoded on the global thread pool. The objects are created
+    // on the manager's thread, parented to the manager
+    QFuture<QList<QObject *> > notificationsAsync(const QString &owner);
+    QFuture<QList<QObject *> > notificationsByCategoryAsync(const QString &category);
+
+    NotificationTable notificationTable(const QString &owner);
+    NotificationTable notificationTableByCategory(const QString &category);
+    void notificationPublished(uint previousId, const NotificationData &data);
+    void notificationRemoved(uint id);
+
     // For platforms where the Notifications interface is hosted on a p2p bus
     static bool useDBusConnection(const QDBusConnection &bus);
+
+    // The manager used by notifications that have not been bound to a specific connection
+    static NotificationConnectionManager *instance();
+    // The manager for a specific connection; each connection has its own proxy
+    static NotificationConnectionManager *instance(const QDBusConnection &bus);
+
+signals:
+    // Forwarded from the current proxy, after delivery to the affected notifications
+    void ActionInvoked(uint id, const QString &actionKey);
+    void NotificationClosed(uint id, uint reason);
+    void InputTextSet(uint id, const QString &inputText);
+
+    void serviceRestarted();
+    void replayFinished(int count, qint64 milliseconds);
+    void offlineQueueDrained(int count);
+
+private slots:
+    void dispatchActionInvoked(uint id, const QString &actionKey);
+    void dispatchNotificationClosed(uint id, uint reason);
+    void dispatchInputTextSet(uint id, const QString &inputText);
+    void dispatchOwnerActionInvoked(const QString &owner, uint id, const QString &actionKey);
+    void dispatchOwnerNotificationClosed(const QString &owner, uint id, uint reason);
+    void dispatchOwnerInputTextSet(const QString &owner, uint id, const QString &inputText);
+    void capabilitiesReceived(QDBusPendingCallWatcher *watcher);
+    void serviceOwnerChanged(const QString &service, const QString &oldOwner, const QString &newOwner);
+    void replayNextBatch();
+    void drainNextBatch();
+    void offlinePublishFinished(QDBusPendingCallWatcher *watcher);
+    void notificationClosed(uint id);
+    void flushGroups();
+    void asyncListingReceived(QDBusPendingCallWatcher *watcher);
+    void closeAllFinished(QDBusPendingCallWatcher *watcher);
+    void flushProgressUpdates();
+    void scheduledPublishFinished(QDBusPendingCallWatcher *watcher);
+    void progressUpdateFinished(QDBusPendingCallWatcher *watcher);
+    void closeListingReceived(QDBusPendingCallWatcher *watcher);
+    void asyncListingDecoded();
+
+private:
+    struct AsyncListing {
+        QFutureInterface<QList<QObject *> > result;
+        NotificationListingCache *listings;
+        QString argument;
+    };
+
+    struct ProgressUpdate {
+        QPointer<Notification> notification;
+        uint id = 0;
+        QVariant value;
+        QVariant sentValue;
+        QElapsedTimer sent;
+        bool pending = false;
+        bool inFlight = false;
+    };
+
+    // Listings are requested either by owner or by category
+    enum ListingKind { OwnerListing, CategoryListing };
+
+    struct CloseRequest {
+        ListingKind kind;
+        QString argument;
+    };
+
+    void createProxy();
+    void updateSubscriptions();
+    void subscribeOwner(const QString &owner, bool subscribe);
+    void resetNotificationIds();
+    void startReplay();
+    void drainOfflineQueue();
+    void publishGroup(const QString &groupId);
+    void scheduleGroupFlush(qint64 delay);
+    QDBusPendingCall requestListing(ListingKind kind, const QString &argument);
+    QFuture<QList<QObject *> > fetchAsync(ListingKind kind, const QString &argument);
+    void dispatchPublishes();
+    void sendProgressUpdate(Notification *notification);
+    void startCloseAll(ListingKind kind, const QString &argument);
+    void closeListed(ListingKind kind, const QString &argument);
+    QList<QObject *> createNotifications(const QList<NotificationData> &notifications);
+    NotificationTable fetchTable(ListingKind kind, const QString &argument);
+
+    QDBusServiceWatcher *m_serviceWatcher = nullptr;
+    QMultiHash<uint, Notification *> m_notifications;
+    QList<QPointer<Notification> > m_replayQueue;
+    QElapsedTimer m_replayTimer;
+    bool m_replayResident = false;
+    bool m_replaying = false;
+    int m_replayBatchSize = 10;
+    int m_replayLimit = 100;
+    int m_replayCount = 0;
+    int m_lastReplayCount = 0;
+    qint64 m_lastReplayDuration = 0;
+    QScopedPointer<NotificationOfflineQueue> m_offlineQueue;
+    QHash<QDBusPendingCallWatcher *, QueuedNotification> m_offlineCalls;
+    int m_offlineDrained = 0;
+    bool m_offlineDrainFailed = false;
+    QScopedPointer<NotificationListingCache> m_ownerListings;
+    QScopedPointer<NotificationListingCache> m_categoryListings;
+    bool m_listingCacheEnabled = false;
+    bool m_subscribed = false;
+    enum { OwnerSignalsUnknown, OwnerSignalsQuerying, OwnerSignalsSupported, OwnerSignalsUnsupported } m_ownerSignals = OwnerSignalsUnknown;
+    QSet<QString> m_subscribedOwners;
+    // The owner of each notification with an ID, and the number of them per owner
+    QHash<Notification *, QString> m_notificationOwners;
+    QHash<QString, int> m_ownerCounts;
+    QHash<QDBusPendingCallWatcher *, AsyncListing> m_listingCalls;
+    QHash<QObject *, AsyncListing> m_listingDecodes;
+    QHash<QDBusPendingCallWatcher *, CloseRequest> m_closeCalls;
+    bool m_closeAllUnsupported = false;
+    QScopedPointer<NotificationPublishScheduler> m_publishScheduler;
+    bool m_asynchronousPublishing = false;
+    QHash<Notification *, ProgressUpdate> m_progressUpdates;
+    QHash<QDBusPendingCallWatcher *, Notification *> m_progressCalls;
+    QTimer *m_progressTimer = nullptr;
+    int m_progressUpdateInterval = 250;
+    qreal m_progressGranularity = 0.01;
+    quint64 m_droppedProgressUpdates = 0;
+    bool m_progressUpdateUnsupported = false;
+    QScopedPointer<NotificationGroups> m_groups;
+    QTimer *m_groupTimer = nullptr;
+    QScopedPointer<NotificationDuplicateFilter> m_duplicateFilter;
+    QScopedPointer<NotificationPublishStatistics> m_publishStatistics;
+    bool m_statisticsExported = false;
+};
+
+// Exports NotificationConnectionManager::statistics() on the manager's connection
+class NotificationStatisticsAdaptor : public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.nemomobile.NotificationStatistics")
+
+public:
+    explicit NotificationStatisticsAdaptor(NotificationConnectionManager *manager);
+
+public slots:
+    QVariantMap GetStatistics() const;
+
+private:
+    NotificationConnectionManager *m_manager;
 };
 
+// Versioned binary encoding of NotificationData, for caching and for exchange between processes.
+// With ReferenceStrings, decoded strings refer to the buffer content rather than copying it, so
+// the buffer (which may be a memory-mapped file) must outlive the decoded data.
+namespace NotificationDataCodec {
+
+enum StringMode { CopyStrings, ReferenceStrings };
+
+NEMO_QML_PLUGIN_NOTIFICATIONS_EXPORT QByteArray encode(const QList<NotificationData> &notifications);
+NEMO_QML_PLUGIN_NOTIFICATIONS_EXPORT bool decode(const QByteArray &buffer, QList<NotificationData> *notifications, StringMode mode = CopyStrings);
+
+}
+
 NEMO_QML_PLUGIN_NOTIFICATIONS_EXPORT QDBusArgument &operator<<(QDBusArgument &, const NotificationData &);
 NEMO_QML_PLUGIN_NOTIFICATIONS_EXPORT const QDBusArgument &operator>>(const QDBusArgument &, NotificationData &);
+NEMO_QML_PLUGIN_NOTIFICATIONS_EXPORT const QDBusArgument &operator>>(const QDBusArgument &, QList<NotificationData> &);
 
 Q_DECLARE_METATYPE(NotificationData)
 Q_DECLARE_METATYPE(QList<NotificationData>)
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+
+#include "notificationduplicatefilter_p.h"
+#include "notificationhints_p.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+
+NotificationDuplicateFilter::Policy NotificationDuplicateFilter::policy() const
+{
+    return m_policy;
+}
+
+void NotificationDuplicateFilter::setPolicy(Policy policy)
+{
+    if (m_policy != policy) {
+        m_policy = policy;
+        // Digests computed under another policy are not comparable
+        m_digests.clear();
+    }
+}
+
+quint64 NotificationDuplicateFilter::skipped() const
+{
+    return m_skipped;
+}
+
+quint64 NotificationDuplicateFilter::refreshed() const
+{
+    return m_refreshed;
+}
+
+bool NotificationDuplicateFilter::filter(NotificationData *data, QByteArray *digest)
+{
+    // The digest covers the encoded content, other than the ID itself and, if it
+    // is to be refreshed, the timestamp. The encoding orders the hints by key, so
+    // equal content always has the same digest
+    NotificationData content(*data);
+    content.setReplacesId(0);
+    if (m_policy == NotificationConnectionManager::RefreshDuplicateTimestamp) {
+        content.removeHint(HINT_TIMESTAMP);
+    }
+    *digest = QCryptographicHash::hash(NotificationDataCodec::encode(QList<NotificationData>() << content),
+                                       QCryptographicHash::Sha1);
+
+    // A new notification has nothing to duplicate; its digest is acknowledged under the ID it is given
+    if (data->replacesId() == 0 || m_digests.value(data->replacesId()).digest != *digest) {
+        return false;
+    }
+
+    if (m_policy == NotificationConnectionManager::SkipDuplicates) {
+        ++m_skipped;
+        return true;
+    }
+
+    ++m_refreshed;
+    data->setHint(HINT_TIMESTAMP, QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+    return false;
+}
+
+void NotificationDuplicateFilter::acknowledge(uint id, const QByteArray &digest, const QVariantHash &hints)
+{
+    PublishedDigest published;
+    published.digest = digest;
+    published.owner = hints.value(HINT_OWNER).toString();
+    published.category = hints.value(HINT_CATEGORY).toString();
+    m_digests.insert(id, published);
+}
+
+void NotificationDuplicateFilter::remove(uint id)
+{
+    m_digests.remove(id);
+}
+
+void NotificationDuplicateFilter::clear()
+{
+    m_digests.clear();
+}
+
+QList<uint> NotificationDuplicateFilter::idsWithOwner(const QString &owner) const
+{
+    QList<uint> ids;
+    for (QHash<uint, PublishedDigest>::const_iterator it = m_digests.constBegin(); it != m_digests.constEnd(); ++it) {
+        if (it.value().owner == owner) {
+            ids.append(it.key());
+        }
+    }
+    return ids;
+}
+
+QList<uint> NotificationDuplicateFilter::idsWithCategory(const QString &category) const
+{
+    QList<uint> ids;
+    for (QHash<uint, PublishedDigest>::const_iterator it = m_digests.constBegin(); it != m_digests.constEnd(); ++it) {
+        if (it.value().category == category) {
+            ids.append(it.key());
+        }
+    }
+    return ids;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+
+#ifndef NOTIFICATIONDUPLICATEFILTER_P_H
+#define NOTIFICATIONDUPLICATEFILTER_P_H
+
+#include "notification_p.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+// Remembers a digest of the content last acknowledged for each notification ID, so that a
+// publication that would not change the notification can be skipped or have its timestamp
+// refreshed, according to the policy
+class NEMO_QML_PLUGIN_NOTIFICATIONS_EXPORT NotificationDuplicateFilter
+{
+public:
+    typedef NotificationConnectionManager::DuplicatePolicy Policy;
+
+    Policy policy() const;
+    void setPolicy(Policy policy);
+    quint64 skipped() const;
+    quint64 refreshed() const;
+
+    // Returns true if the publication of data should be skipped. Otherwise, provides the digest
+    // to be acknowledged under the ID the notification has once it is published
+    bool filter(NotificationData *data, QByteArray *digest);
+    void acknowledge(uint id, const QByteArray &digest, const QVariantHash &hints);
+    void remove(uint id);
+    void clear();
+
+    // The IDs of acknowledged notifications with the given owner or category
+    QList<uint> idsWithOwner(const QString &owner) const;
+    QList<uint> idsWithCategory(const QString &category) const;
+
+private:
+    // The owner and category are kept so that the state of notifications closed in bulk can be discarded
+    struct PublishedDigest {
+        QByteArray digest;
+        QString owner;
+        QString category;
+    };
+
+    QHash<uint, PublishedDigest> m_digests;
+    Policy m_policy = NotificationConnectionManager::PublishDuplicates;
+    quint64 m_skipped = 0;
+    quint64 m_refreshed = 0;
+};
+
+#endif // NOTIFICATIONDUPLICATEFILTER_P_H
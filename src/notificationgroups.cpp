@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+
+#include "notificationgroups_p.h"
+#include "notification.h"
+#include "notificationhints_p.h"
+
+int NotificationGroups::window() const
+{
+    return m_window;
+}
+
+void NotificationGroups::setWindow(int milliseconds)
+{
+    m_window = qMax(0, milliseconds);
+}
+
+quint64 NotificationGroups::collapsedUpdates() const
+{
+    return m_collapsedUpdates;
+}
+
+bool NotificationGroups::isEmpty() const
+{
+    return m_groups.isEmpty();
+}
+
+bool NotificationGroups::contains(const QString &groupId) const
+{
+    return m_groups.contains(groupId);
+}
+
+uint NotificationGroups::summaryId(const QString &groupId) const
+{
+    return m_groups.value(groupId).id;
+}
+
+int NotificationGroups::itemCount(const QString &groupId) const
+{
+    return m_groups.value(groupId).itemCount;
+}
+
+QString NotificationGroups::owner(const QString &groupId) const
+{
+    return m_groups.value(groupId).owner;
+}
+
+QStringList NotificationGroups::owners() const
+{
+    QStringList rv;
+    for (const Group &group : m_groups) {
+        rv.append(group.owner);
+    }
+    return rv;
+}
+
+bool NotificationGroups::bundle(const QString &groupId, NotificationData *data, Notification *notification)
+{
+    Group &group(m_groups[groupId]);
+    // A member that is published again replaces its previous contribution
+    const int itemCount = qMax(1, data->hints().value(HINT_ITEM_COUNT).toInt());
+    group.itemCount += itemCount - group.members.value(notification);
+    group.members.insert(notification, itemCount);
+
+    const bool recent = m_window > 0 && !group.updated.hasExpired(m_window);
+    if (group.publishing || (group.id != 0 && recent)) {
+        // Too soon after the last update, or the summary does not exist yet; publish the
+        // latest member when the window closes and the summary has been published
+        if (group.hasPending) {
+            ++m_collapsedUpdates;
+            if (group.pending.notification && group.pending.notification != notification) {
+                group.collapsed.append(group.pending.notification);
+            }
+        }
+        group.pendingMembers.insert(notification, itemCount);
+        group.pending.data = *data;
+        group.pending.notification = notification;
+        group.hasPending = true;
+        return true;
+    }
+
+    // Publish now, as the current state of the summary
+    if (group.id != 0) {
+        data->setReplacesId(group.id);
+    }
+    data->setHint(HINT_ITEM_COUNT, group.itemCount);
+    group.owner = data->hints().value(HINT_OWNER).toString();
+    group.category = data->hints().value(HINT_CATEGORY).toString();
+    group.publishing = (group.id == 0);
+    group.updated.start();
+    return false;
+}
+
+void NotificationGroups::published(const QString &groupId, uint id)
+{
+    QHash<QString, Group>::iterator it = m_groups.find(groupId);
+    if (it != m_groups.end()) {
+        it.value().publishing = false;
+        if (id != 0) {
+            it.value().id = id;
+        }
+    }
+}
+
+void NotificationGroups::removeMember(const QString &groupId, Notification *notification, bool withdrawn)
+{
+    QHash<QString, Group>::iterator it = m_groups.find(groupId);
+    if (it == m_groups.end()) {
+        return;
+    }
+
+    Group &group(it.value());
+    QHash<Notification *, int>::iterator member = group.members.find(notification);
+    if (member != group.members.end()) {
+        if (withdrawn) {
+            group.itemCount -= member.value();
+        }
+        group.members.erase(member);
+    }
+    member = group.pendingMembers.find(notification);
+    if (member != group.pendingMembers.end()) {
+        if (!withdrawn) {
+            group.detachedItems += member.value();
+        }
+        group.pendingMembers.erase(member);
+    }
+    if (withdrawn) {
+        // The summary update is still published, but no longer on behalf of this member
+        group.collapsed.removeAll(QPointer<Notification>(notification));
+        if (group.pending.notification == notification) {
+            group.pending.notification.clear();
+        }
+    }
+}
+
+qint64 NotificationGroups::remaining(const Group &group) const
+{
+    return group.updated.isValid() ? qMax<qint64>(0, m_window - group.updated.elapsed()) : 0;
+}
+
+qint64 NotificationGroups::flushDelay(const QString &groupId) const
+{
+    QHash<QString, Group>::const_iterator it = m_groups.constFind(groupId);
+    if (it == m_groups.constEnd() || !it.value().hasPending || it.value().publishing) {
+        // Groups whose summary is being published are flushed when it completes
+        return -1;
+    }
+    return remaining(it.value());
+}
+
+QStringList NotificationGroups::dueGroups(qint64 *next) const
+{
+    QStringList due;
+    *next = -1;
+    for (QHash<QString, Group>::const_iterator it = m_groups.constBegin(); it != m_groups.constEnd(); ++it) {
+        const qint64 delay = flushDelay(it.key());
+        if (delay > 0) {
+            *next = *next < 0 ? delay : qMin(*next, delay);
+        } else if (delay == 0) {
+            due.append(it.key());
+        }
+    }
+    return due;
+}
+
+bool NotificationGroups::takePending(const QString &groupId, NotificationData *data, QList<QPointer<Notification> > *members)
+{
+    QHash<QString, Group>::iterator it = m_groups.find(groupId);
+    if (it == m_groups.end() || !it.value().hasPending || it.value().publishing) {
+        return false;
+    }
+
+    Group &group(it.value());
+    *data = group.pending.data;
+    data->setReplacesId(group.id);
+    data->setHint(HINT_ITEM_COUNT, group.itemCount);
+
+    *members = group.collapsed;
+    members->append(group.pending.notification);
+    group.pending = QueuedNotification();
+    group.hasPending = false;
+    group.pendingMembers.clear();
+    group.detachedItems = 0;
+    group.collapsed.clear();
+    group.owner = data->hints().value(HINT_OWNER).toString();
+    group.category = data->hints().value(HINT_CATEGORY).toString();
+    group.updated.start();
+    return true;
+}
+
+bool NotificationGroups::summaryRemoved(uint id)
+{
+    // A closed summary notification is not reused; pending members start a new one
+    bool removed = false;
+    for (QHash<QString, Group>::iterator it = m_groups.begin(); it != m_groups.end(); ) {
+        Group &group(it.value());
+        if (group.id == id) {
+            if (!group.hasPending) {
+                it = m_groups.erase(it);
+                removed = true;
+                continue;
+            }
+            group.id = 0;
+            group.members = group.pendingMembers;
+            group.itemCount = group.detachedItems;
+            group.detachedItems = 0;
+            for (int count : group.members) {
+                group.itemCount += count;
+            }
+        }
+        ++it;
+    }
+    return removed;
+}
+
+void NotificationGroups::resetIds()
+{
+    for (Group &group : m_groups) {
+        group.id = 0;
+    }
+}
+
+QList<uint> NotificationGroups::idsWithOwner(const QString &owner) const
+{
+    QList<uint> ids;
+    for (const Group &group : m_groups) {
+        if (group.id != 0 && group.owner == owner) {
+            ids.append(group.id);
+        }
+    }
+    return ids;
+}
+
+QList<uint> NotificationGroups::idsWithCategory(const QString &category) const
+{
+    QList<uint> ids;
+    for (const Group &group : m_groups) {
+        if (group.id != 0 && group.category == category) {
+            ids.append(group.id);
+        }
+    }
+    return ids;
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+
+#ifndef NOTIFICATIONGROUPS_P_H
+#define NOTIFICATIONGROUPS_P_H
+
+#include "notification_p.h"
+
+#include <QHash>
+#include <QList>
+#include <QPointer>
+#include <QStringList>
+
+// Bundles notifications with a group ID into one summary notification per group, whose item
+// count accumulates those of its members. Updates arriving within the grouping window of the
+// last publication of the summary are collapsed into one pending update. Publishing the
+// summary and scheduling the pending updates is left to the owner
+class NEMO_QML_PLUGIN_NOTIFICATIONS_EXPORT NotificationGroups
+{
+public:
+    int window() const;
+    void setWindow(int milliseconds);
+    quint64 collapsedUpdates() const;
+
+    bool isEmpty() const;
+    bool contains(const QString &groupId) const;
+    uint summaryId(const QString &groupId) const;
+    int itemCount(const QString &groupId) const;
+    QString owner(const QString &groupId) const;
+    QStringList owners() const;
+
+    // Returns true if the member is held as the pending update of the group. Otherwise, data
+    // is updated to be published now as the summary, and published() must follow
+    bool bundle(const QString &groupId, NotificationData *data, Notification *notification);
+    // Called with a zero ID if the publication failed
+    void published(const QString &groupId, uint id);
+    void removeMember(const QString &groupId, Notification *notification, bool withdrawn);
+
+    // The time until the pending update of a group should be published, or -1 if there is none
+    // that can be published yet
+    qint64 flushDelay(const QString &groupId) const;
+    // The groups whose pending update should be published now, and the time until the next is due
+    QStringList dueGroups(qint64 *next) const;
+    // Takes the pending update of a group as the summary to publish, and the members it represents
+    bool takePending(const QString &groupId, NotificationData *data, QList<QPointer<Notification> > *members);
+
+    // Returns true if a group was forgotten because its summary was removed
+    bool summaryRemoved(uint id);
+    // Summaries do not survive the service; the next update of each group creates a new one
+    void resetIds();
+    QList<uint> idsWithOwner(const QString &owner) const;
+    QList<uint> idsWithCategory(const QString &category) const;
+
+private:
+    struct Group {
+        uint id = 0;
+        QString owner;
+        QString category;
+        int itemCount = 0;
+        // The item count of each member, and of those updated since the summary was last published
+        QHash<Notification *, int> members;
+        QHash<Notification *, int> pendingMembers;
+        // The item count of pending members that were destroyed before being published
+        int detachedItems = 0;
+        QElapsedTimer updated;
+        // The first publication of the summary is outstanding, so its ID is not yet known
+        bool publishing = false;
+        bool hasPending = false;
+        QueuedNotification pending;
+        QList<QPointer<Notification> > collapsed;
+    };
+
+    qint64 remaining(const Group &group) const;
+
+    QHash<QString, Group> m_groups;
+    int m_window = 1000;
+    quint64 m_collapsedUpdates = 0;
+};
+
+#endif // NOTIFICATIONGROUPS_P_H
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+
+#include "notificationlistingcache_p.h"
+
+const QList<NotificationData> *NotificationListingCache::find(const QString &key, bool countMiss)
+{
+    QHash<QString, QList<NotificationData> >::const_iterator it = m_listings.constFind(key);
+    if (it != m_listings.constEnd()) {
+        ++m_hits;
+        return &it.value();
+    }
+    if (countMiss) {
+        ++m_misses;
+    }
+    return nullptr;
+}
+
+void NotificationListingCache::insert(const QString &key, const QList<NotificationData> &listing)
+{
+    m_listings.insert(key, listing);
+}
+
+void NotificationListingCache::published(const QString &key, const NotificationData &data)
+{
+    // Replace the notification in the listing it belongs to, and remove it from any others
+    for (QHash<QString, QList<NotificationData> >::iterator it = m_listings.begin(); it != m_listings.end(); ++it) {
+        QList<NotificationData> &listing(it.value());
+        int index = 0;
+        while (index < listing.count() && listing.at(index).replacesId() != data.replacesId()) {
+            ++index;
+        }
+
+        if (it.key() == key) {
+            if (index < listing.count()) {
+                listing[index] = data;
+            } else {
+                listing.append(data);
+            }
+        } else if (index < listing.count()) {
+            listing.removeAt(index);
+        }
+    }
+}
+
+void NotificationListingCache::removed(uint id)
+{
+    for (QHash<QString, QList<NotificationData> >::iterator it = m_listings.begin(); it != m_listings.end(); ++it) {
+        QList<NotificationData> &listing(it.value());
+        for (int i = 0; i < listing.count(); ++i) {
+            if (listing.at(i).replacesId() == id) {
+                listing.removeAt(i);
+                break;
+            }
+        }
+    }
+}
+
+void NotificationListingCache::clear()
+{
+    m_listings.clear();
+}
+
+bool NotificationListingCache::isEmpty() const
+{
+    return m_listings.isEmpty();
+}
+
+QList<QString> NotificationListingCache::keys() const
+{
+    return m_listings.keys();
+}
+
+int NotificationListingCache::count() const
+{
+    return m_listings.count();
+}
+
+int NotificationListingCache::notificationCount() const
+{
+    int count = 0;
+    for (const QList<NotificationData> &listing : m_listings) {
+        count += listing.count();
+    }
+    return count;
+}
+
+quint64 NotificationListingCache::hits() const
+{
+    return m_hits;
+}
+
+quint64 NotificationListingCache::misses() const
+{
+    return m_misses;
+}
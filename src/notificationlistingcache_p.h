@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+
+#ifndef NOTIFICATIONLISTINGCACHE_P_H
+#define NOTIFICATIONLISTINGCACHE_P_H
+
+#include "notification_p.h"
+
+#include <QHash>
+#include <QList>
+#include <QString>
+
+// Local copies of the listings for one kind of key, either owners or categories. A listing is
+// filled by the first query for its key, and then maintained from our own publications and
+// from the closures we are told about
+class NEMO_QML_PLUGIN_NOTIFICATIONS_EXPORT NotificationListingCache
+{
+public:
+    // Returns the listing for key if it is cached, counting a hit, or else null. A miss is
+    // counted only if countMiss is set, since not every caller could fill the listing
+    const QList<NotificationData> *find(const QString &key, bool countMiss = true);
+    void insert(const QString &key, const QList<NotificationData> &listing);
+
+    // A notification belongs only to the listing for key, if that listing is cached
+    void published(const QString &key, const NotificationData &data);
+    void removed(uint id);
+    void clear();
+
+    bool isEmpty() const;
+    QList<QString> keys() const;
+    int count() const;
+    int notificationCount() const;
+
+    quint64 hits() const;
+    quint64 misses() const;
+
+private:
+    QHash<QString, QList<NotificationData> > m_listings;
+    quint64 m_hits = 0;
+    quint64 m_misses = 0;
+};
+
+#endif // NOTIFICATIONLISTINGCACHE_P_H
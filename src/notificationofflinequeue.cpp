@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+
+#include "notificationofflinequeue_p.h"
+#include "notification.h"
+#include "notificationhints_p.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace {
+
+bool supersedes(const QueuedNotification &queued, const NotificationData &data, const Notification *notification)
+{
+    return (notification && queued.notification == notification)
+            || (data.replacesId() != 0 && queued.data.replacesId() == data.replacesId());
+}
+
+}
+
+int NotificationOfflineQueue::limit() const
+{
+    return m_limit;
+}
+
+void NotificationOfflineQueue::setLimit(int limit)
+{
+    m_limit = qMax(0, limit);
+    while (m_entries.count() > m_limit) {
+        m_entries.removeFirst();
+    }
+    save();
+}
+
+QString NotificationOfflineQueue::file() const
+{
+    return m_file;
+}
+
+void NotificationOfflineQueue::setFile(const QString &path)
+{
+    if (m_file != path) {
+        m_file = path;
+        // The file is only rewritten when the queue next changes
+        load();
+    }
+}
+
+int NotificationOfflineQueue::count() const
+{
+    return m_entries.count();
+}
+
+bool NotificationOfflineQueue::isEmpty() const
+{
+    return m_entries.isEmpty();
+}
+
+bool NotificationOfflineQueue::isDraining() const
+{
+    return m_draining;
+}
+
+void NotificationOfflineQueue::setDraining(bool draining)
+{
+    if (m_draining != draining) {
+        m_draining = draining;
+        save();
+    }
+}
+
+void NotificationOfflineQueue::enqueue(const NotificationData &data, Notification *notification)
+{
+    for (int i = 0; i < m_entries.count(); ++i) {
+        if (supersedes(m_entries.at(i), data, notification)) {
+            m_entries.removeAt(i);
+            break;
+        }
+    }
+
+    if (m_entries.count() >= m_limit && !m_entries.isEmpty()) {
+        // Supersede the oldest notification in the same category, or else the oldest of all
+        const QString category(data.hints().value(HINT_CATEGORY).toString());
+        int index = 0;
+        if (!category.isEmpty()) {
+            for (int i = 0; i < m_entries.count(); ++i) {
+                if (m_entries.at(i).data.hints().value(HINT_CATEGORY).toString() == category) {
+                    index = i;
+                    break;
+                }
+            }
+        }
+        qWarning() << "Notification queue full, dropping:" << m_entries.at(index).data.summary();
+        m_entries.removeAt(index);
+    }
+
+    QueuedNotification queued;
+    queued.data = data;
+    queued.notification = notification;
+    m_entries.append(queued);
+    save();
+}
+
+void NotificationOfflineQueue::cancel(Notification *notification)
+{
+    for (int i = 0; i < m_entries.count(); ++i) {
+        if (m_entries.at(i).notification == notification) {
+            m_entries.removeAt(i);
+            save();
+            break;
+        }
+    }
+}
+
+QueuedNotification NotificationOfflineQueue::takeFirst()
+{
+    return m_entries.takeFirst();
+}
+
+void NotificationOfflineQueue::requeue(const QueuedNotification &queued)
+{
+    for (const QueuedNotification &pending : m_entries) {
+        if (supersedes(pending, queued.data, queued.notification)) {
+            return;
+        }
+    }
+    m_entries.prepend(queued);
+}
+
+void NotificationOfflineQueue::load()
+{
+    QFile file(m_file);
+    if (m_file.isEmpty() || !file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    QList<NotificationData> notifications;
+    if (!NotificationDataCodec::decode(file.readAll(), &notifications)) {
+        qWarning() << "Ignoring invalid notification queue file:" << m_file;
+        return;
+    }
+
+    // Everything saved is restored, whatever the current limit; entries are only
+    // dropped from the file when the queue is next saved
+    for (const NotificationData &data : notifications) {
+        QueuedNotification queued;
+        queued.data = data;
+        m_entries.append(queued);
+    }
+}
+
+void NotificationOfflineQueue::save()
+{
+    if (m_file.isEmpty() || m_draining) {
+        return;
+    }
+
+    if (m_entries.isEmpty()) {
+        QFile::remove(m_file);
+        return;
+    }
+
+    QDir().mkpath(QFileInfo(m_file).absolutePath());
+    QSaveFile file(m_file);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Unable to write notification queue file:" << m_file;
+        return;
+    }
+
+    QList<NotificationData> notifications;
+    for (const QueuedNotification &queued : m_entries) {
+        notifications.append(queued.data);
+    }
+    file.write(NotificationDataCodec::encode(notifications));
+    file.commit();
+}
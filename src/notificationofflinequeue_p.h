@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+
+#ifndef NOTIFICATIONOFFLINEQUEUE_P_H
+#define NOTIFICATIONOFFLINEQUEUE_P_H
+
+#include "notification_p.h"
+
+#include <QList>
+#include <QString>
+
+// Holds notifications published while the service is absent, optionally persisted to a file
+// so that they survive a restart. Only the latest content of each notification is retained
+class NEMO_QML_PLUGIN_NOTIFICATIONS_EXPORT NotificationOfflineQueue
+{
+public:
+    int limit() const;
+    void setLimit(int limit);
+    QString file() const;
+    void setFile(const QString &path);
+    int count() const;
+    bool isEmpty() const;
+
+    // While draining, the file is left untouched so that nothing in flight is lost
+    // if the process exits; it is rewritten once draining ends
+    bool isDraining() const;
+    void setDraining(bool draining);
+
+    void enqueue(const NotificationData &data, Notification *notification);
+    void cancel(Notification *notification);
+    QueuedNotification takeFirst();
+    // Returns an entry whose publication failed to the front of the queue, unless it has since been superseded
+    void requeue(const QueuedNotification &queued);
+
+private:
+    void load();
+    void save();
+
+    QList<QueuedNotification> m_entries;
+    QString m_file;
+    int m_limit = 0;
+    bool m_draining = false;
+};
+
+#endif // NOTIFICATIONOFFLINEQUEUE_P_H
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+
+#include "notificationpublishscheduler_p.h"
+#include "notification.h"
+
+int NotificationPublishScheduler::maxInFlight() const
+{
+    return m_maxInFlight;
+}
+
+void NotificationPublishScheduler::setMaxInFlight(int count)
+{
+    m_maxInFlight = qMax(1, count);
+}
+
+int NotificationPublishScheduler::reservedCritical() const
+{
+    return m_reservedCritical;
+}
+
+void NotificationPublishScheduler::setReservedCritical(int count)
+{
+    m_reservedCritical = qMax(0, count);
+}
+
+int NotificationPublishScheduler::queueDepth() const
+{
+    int depth = m_held.count();
+    for (const QList<ScheduledPublish> &lane : m_lanes) {
+        depth += lane.count();
+    }
+    return depth;
+}
+
+int NotificationPublishScheduler::peakQueueDepth() const
+{
+    return m_peakQueueDepth;
+}
+
+int NotificationPublishScheduler::inFlight() const
+{
+    return m_calls.count();
+}
+
+quint64 NotificationPublishScheduler::merged() const
+{
+    return m_merged;
+}
+
+qint64 NotificationPublishScheduler::maxWait() const
+{
+    return m_maxWait;
+}
+
+qint64 NotificationPublishScheduler::maxWait(int urgency) const
+{
+    return m_maxLaneWait[qBound(static_cast<int>(Notification::Low), urgency, static_cast<int>(Notification::Critical))];
+}
+
+qint64 NotificationPublishScheduler::averageWait() const
+{
+    return m_dispatched ? m_totalWait / static_cast<qint64>(m_dispatched) : 0;
+}
+
+bool NotificationPublishScheduler::isSame(const ScheduledPublish &entry, const Notification *notification, uint replacesId)
+{
+    return (notification && entry.notification == notification)
+            || (replacesId != 0 && entry.data.replacesId() == replacesId);
+}
+
+QPointer<NotificationQueue> NotificationPublishScheduler::schedule(ScheduledPublish entry)
+{
+    const Notification *notification = entry.notification.data();
+    const uint replacesId = entry.data.replacesId();
+    entry.urgency = qBound(static_cast<int>(Notification::Low), entry.urgency, static_cast<int>(Notification::Critical));
+
+    // A queued update of the same notification is superseded, but keeps its waiting time
+    QPointer<NotificationQueue> supersededQueue;
+    for (QList<ScheduledPublish> &lane : m_lanes) {
+        for (int i = 0; i < lane.count(); ++i) {
+            const ScheduledPublish &queued(lane.at(i));
+            if (isSame(queued, notification, replacesId)) {
+                entry.queued = queued.queued;
+                supersededQueue = queued.queue;
+                lane.removeAt(i);
+                ++m_merged;
+                break;
+            }
+        }
+    }
+    for (QHash<QDBusPendingCallWatcher *, ScheduledPublish>::iterator it = m_held.begin(); it != m_held.end(); ++it) {
+        if (isSame(it.value(), notification, replacesId)) {
+            entry.queued = it.value().queued;
+            supersededQueue = it.value().queue;
+            m_held.erase(it);
+            ++m_merged;
+            break;
+        }
+    }
+    if (!entry.queued.isValid()) {
+        entry.queued.start();
+    }
+
+    // While the same notification is being published its ID may not be known yet, so the update
+    // is held until that call completes, and is then published with the ID from its reply
+    QDBusPendingCallWatcher *inFlight = nullptr;
+    for (QHash<QDBusPendingCallWatcher *, ScheduledPublish>::const_iterator it = m_calls.constBegin(); it != m_calls.constEnd(); ++it) {
+        if (isSame(it.value(), notification, replacesId)) {
+            inFlight = it.key();
+            break;
+        }
+    }
+
+    if (inFlight) {
+        m_held.insert(inFlight, entry);
+    } else {
+        m_lanes[entry.urgency].append(entry);
+    }
+    m_peakQueueDepth = qMax(m_peakQueueDepth, queueDepth());
+    return supersededQueue;
+}
+
+void NotificationPublishScheduler::cancel(Notification *notification, QList<ScheduledPublish> *queued, QList<ScheduledPublish> *held)
+{
+    for (QList<ScheduledPublish> &lane : m_lanes) {
+        for (int i = lane.count() - 1; i >= 0; --i) {
+            if (lane.at(i).notification == notification) {
+                queued->append(lane.takeAt(i));
+            }
+        }
+    }
+    for (QHash<QDBusPendingCallWatcher *, ScheduledPublish>::iterator it = m_held.begin(); it != m_held.end(); ) {
+        if (it.value().notification == notification) {
+            held->append(it.value());
+            it = m_held.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    // Publications already sent cannot be recalled; what they create is closed when they reply
+    for (ScheduledPublish &entry : m_calls) {
+        if (entry.notification == notification) {
+            entry.cancelled = true;
+        }
+    }
+}
+
+bool NotificationPublishScheduler::takeNext(ScheduledPublish *entry)
+{
+    int urgency = Notification::Critical;
+    while (urgency >= Notification::Low && m_lanes[urgency].isEmpty()) {
+        --urgency;
+    }
+    if (urgency < Notification::Low) {
+        return false;
+    }
+
+    // Some capacity is kept free for critical updates, so they need not wait for others to complete
+    const int limit = urgency == Notification::Critical
+            ? m_maxInFlight
+            : qMax(1, m_maxInFlight - m_reservedCritical);
+    if (m_calls.count() >= limit) {
+        return false;
+    }
+
+    *entry = m_lanes[urgency].takeFirst();
+    const qint64 wait = entry->queued.elapsed();
+    m_maxWait = qMax(m_maxWait, wait);
+    m_maxLaneWait[urgency] = qMax(m_maxLaneWait[urgency], wait);
+    m_totalWait += wait;
+    ++m_dispatched;
+    return true;
+}
+
+void NotificationPublishScheduler::sent(QDBusPendingCallWatcher *watcher, const ScheduledPublish &entry)
+{
+    m_calls.insert(watcher, entry);
+}
+
+ScheduledPublish NotificationPublishScheduler::finished(QDBusPendingCallWatcher *watcher, uint id)
+{
+    const ScheduledPublish entry(m_calls.take(watcher));
+
+    // An update held behind this call can now be sent, replacing the notification it created
+    QHash<QDBusPendingCallWatcher *, ScheduledPublish>::iterator held = m_held.find(watcher);
+    if (held != m_held.end()) {
+        ScheduledPublish next(held.value());
+        m_held.erase(held);
+        if (id != 0 && next.data.replacesId() == entry.data.replacesId()) {
+            next.data.setReplacesId(id);
+        }
+        m_lanes[next.urgency].append(next);
+    }
+    return entry;
+}
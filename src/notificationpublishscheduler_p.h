@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+
+#ifndef NOTIFICATIONPUBLISHSCHEDULER_P_H
+#define NOTIFICATIONPUBLISHSCHEDULER_P_H
+
+#include "notification_p.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QPointer>
+
+struct ScheduledPublish {
+    NotificationData data;
+    QPointer<Notification> notification;
+    QByteArray digest;
+    QPointer<NotificationQueue> queue;
+    int urgency = 0;
+    QElapsedTimer queued;
+    QElapsedTimer sent;
+    // The notification was closed while this publication was in flight
+    bool cancelled = false;
+};
+
+// Orders asynchronous publications. Each urgency has its own lane, so urgent updates never wait
+// behind less urgent ones, and some of the calls in flight are reserved for critical updates.
+// The calls themselves are made by the owner, which reports each one sent and finished
+class NEMO_QML_PLUGIN_NOTIFICATIONS_EXPORT NotificationPublishScheduler
+{
+public:
+    int maxInFlight() const;
+    void setMaxInFlight(int count);
+    int reservedCritical() const;
+    void setReservedCritical(int count);
+
+    int queueDepth() const;
+    int peakQueueDepth() const;
+    int inFlight() const;
+    quint64 merged() const;
+    qint64 maxWait() const;
+    qint64 maxWait(int urgency) const;
+    qint64 averageWait() const;
+
+    // Queues an update, superseding any queued update of the same notification; returns the
+    // queue of the superseded update, which is not sent
+    QPointer<NotificationQueue> schedule(ScheduledPublish entry);
+    // Removes the updates of a notification that are queued, or held behind one in flight;
+    // those already in flight are marked as cancelled
+    void cancel(Notification *notification, QList<ScheduledPublish> *queued, QList<ScheduledPublish> *held);
+    // Takes the next update to send, if there is capacity to send it
+    bool takeNext(ScheduledPublish *entry);
+    void sent(QDBusPendingCallWatcher *watcher, const ScheduledPublish &entry);
+    // Returns the update sent by the call, and queues any update held behind it with the ID
+    // from the reply, which is zero if the call failed
+    ScheduledPublish finished(QDBusPendingCallWatcher *watcher, uint id);
+
+private:
+    static bool isSame(const ScheduledPublish &entry, const Notification *notification, uint replacesId);
+
+    QList<ScheduledPublish> m_lanes[3];
+    QHash<QDBusPendingCallWatcher *, ScheduledPublish> m_calls;
+    // The latest update of a notification whose publication is in flight, by the call it waits for
+    QHash<QDBusPendingCallWatcher *, ScheduledPublish> m_held;
+    int m_maxInFlight = 4;
+    int m_reservedCritical = 1;
+    int m_peakQueueDepth = 0;
+    quint64 m_merged = 0;
+    quint64 m_dispatched = 0;
+    qint64 m_maxWait = 0;
+    qint64 m_maxLaneWait[3] = { 0, 0, 0 };
+    qint64 m_totalWait = 0;
+};
+
+#endif // NOTIFICATIONPUBLISHSCHEDULER_P_H
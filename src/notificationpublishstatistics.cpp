@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+
+#include "notificationpublishstatistics_p.h"
+
+#include <algorithm>
+
+namespace {
+
+const int sampleLimit = 256;
+
+}
+
+bool NotificationPublishStatistics::isSampling() const
+{
+    return m_sampling;
+}
+
+void NotificationPublishStatistics::setSampling(bool sampling)
+{
+    m_sampling = sampling;
+    if (!sampling) {
+        m_latencies.clear();
+        m_nextLatency = 0;
+    }
+}
+
+quint64 NotificationPublishStatistics::completed() const
+{
+    return m_completed;
+}
+
+quint64 NotificationPublishStatistics::failed() const
+{
+    return m_failed;
+}
+
+void NotificationPublishStatistics::record(qint64 latency, bool published)
+{
+    if (published) {
+        ++m_completed;
+    } else {
+        ++m_failed;
+    }
+
+    if (m_sampling) {
+        // The most recent samples are kept in a ring
+        if (m_latencies.count() < sampleLimit) {
+            m_latencies.append(latency);
+        } else {
+            m_latencies[m_nextLatency] = latency;
+            m_nextLatency = (m_nextLatency + 1) % sampleLimit;
+        }
+    }
+}
+
+void NotificationPublishStatistics::insertInto(QVariantMap *statistics) const
+{
+    statistics->insert(QStringLiteral("publishes"), m_completed);
+    statistics->insert(QStringLiteral("failedPublishes"), m_failed);
+
+    QVector<qint64> latencies(m_latencies);
+    statistics->insert(QStringLiteral("publishLatencySamples"), latencies.count());
+    if (!latencies.isEmpty()) {
+        std::sort(latencies.begin(), latencies.end());
+        const int last = latencies.count() - 1;
+        statistics->insert(QStringLiteral("publishLatencyP50"), latencies.at(last * 50 / 100));
+        statistics->insert(QStringLiteral("publishLatencyP90"), latencies.at(last * 90 / 100));
+        statistics->insert(QStringLiteral("publishLatencyP99"), latencies.at(last * 99 / 100));
+        statistics->insert(QStringLiteral("publishLatencyMax"), latencies.at(last));
+    }
+}
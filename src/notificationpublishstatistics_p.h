@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+
+#ifndef NOTIFICATIONPUBLISHSTATISTICS_P_H
+#define NOTIFICATIONPUBLISHSTATISTICS_P_H
+
+#include "notification_p.h"
+
+#include <QVariantMap>
+#include <QVector>
+
+// Counts completed and failed publications and, while sampling, keeps the most recent
+// Notify latencies in a ring from which percentiles are reported
+class NEMO_QML_PLUGIN_NOTIFICATIONS_EXPORT NotificationPublishStatistics
+{
+public:
+    bool isSampling() const;
+    // Samples are discarded when sampling stops
+    void setSampling(bool sampling);
+
+    quint64 completed() const;
+    quint64 failed() const;
+
+    // The latency is in microseconds, from the Notify call to its reply
+    void record(qint64 latency, bool published);
+    void insertInto(QVariantMap *statistics) const;
+
+private:
+    QVector<qint64> m_latencies;
+    int m_nextLatency = 0;
+    quint64 m_completed = 0;
+    quint64 m_failed = 0;
+    bool m_sampling = false;
+};
+
+#endif // NOTIFICATIONPUBLISHSTATISTICS_P_H
@@ -0,0 +1,301 @@
+/*
+ * Copyright (C) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "notificationqueue.h"
+#include "notification.h"
+
+/*!
+    \qmltype NotificationQueue
+    \brief Publishes a batch of notifications together
+    \inqmlmodule Nemo.Notifications
+
+    NotificationQueue collects notifications passed to enqueue() and publishes them together,
+    either when \l interval has elapsed after the first of them was added or when flush() is
+    called. The notifications of a batch are published concurrently, without waiting for each
+    other, and finished() is emitted once the notification server has replied to all of them.
+
+    \qml
+    NotificationQueue {
+        id: queue
+        onFinished: console.log("Published", published, "notifications")
+    }
+
+    Repeater {
+        model: messages
+        delegate: Notification {
+            summary: model.sender
+            body: model.text
+            Component.onCompleted: queue.enqueue(this)
+        }
+    }
+    \endqml
+*/
+/*!
+    \class NotificationQueue
+    \brief Publishes a batch of notifications together
+    \inmodule NemoNotifications
+
+    NotificationQueue collects notifications passed to enqueue() and publishes them together,
+    either when \l interval has elapsed after the first of them was added or when flush() is
+    called. The notifications of a batch are published concurrently, without waiting for each
+    other, and finished() is emitted once the notification server has replied to all of them.
+ */
+NotificationQueue::NotificationQueue(QObject *parent)
+    : QObject(parent)
+    , m_autoFlush(true)
+    , m_outstanding(0)
+    , m_published(0)
+    , m_failed(0)
+{
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(0);
+    connect(&m_timer, SIGNAL(timeout()), this, SLOT(flush()));
+}
+
+NotificationQueue::~NotificationQueue()
+{
+}
+
+/*!
+    \qmlproperty int NotificationQueue::interval
+
+    The time in milliseconds from the first notification being enqueued until the batch is published,
+    if \l autoFlush is enabled. Defaults to 0, which publishes the batch once control returns to
+    the event loop.
+*/
+/*!
+    \property NotificationQueue::interval
+
+    The time in milliseconds from the first notification being enqueued until the batch is published,
+    if \l autoFlush is enabled. Defaults to 0, which publishes the batch once control returns to
+    the event loop.
+ */
+int NotificationQueue::interval() const
+{
+    return m_timer.interval();
+}
+
+void NotificationQueue::setInterval(int milliseconds)
+{
+    milliseconds = qMax(0, milliseconds);
+    if (milliseconds != m_timer.interval()) {
+        m_timer.setInterval(milliseconds);
+        emit intervalChanged();
+    }
+}
+
+/*!
+    \qmlproperty bool NotificationQueue::autoFlush
+
+    Whether enqueued notifications are published automatically after \l interval.
+    If disabled, they are only published by flush(). Defaults to true.
+*/
+/*!
+    \property NotificationQueue::autoFlush
+
+    Whether enqueued notifications are published automatically after \l interval.
+    If disabled, they are only published by flush(). Defaults to true.
+ */
+bool NotificationQueue::autoFlush() const
+{
+    return m_autoFlush;
+}
+
+void NotificationQueue::setAutoFlush(bool autoFlush)
+{
+    if (autoFlush != m_autoFlush) {
+        m_autoFlush = autoFlush;
+        if (!m_autoFlush) {
+            m_timer.stop();
+        } else if (!m_pending.isEmpty()) {
+            m_timer.start();
+        }
+        emit autoFlushChanged();
+    }
+}
+
+/*!
+    \qmlproperty int NotificationQueue::pending
+
+    The number of notifications waiting to be published.
+*/
+/*!
+    \property NotificationQueue::pending
+
+    The number of notifications waiting to be published.
+ */
+int NotificationQueue::pending() const
+{
+    return m_pending.count();
+}
+
+/*!
+    \qmlproperty bool NotificationQueue::active
+
+    True while published notifications are awaiting a reply from the notification server.
+*/
+/*!
+    \property NotificationQueue::active
+
+    True while published notifications are awaiting a reply from the notification server.
+ */
+bool NotificationQueue::active() const
+{
+    return m_outstanding > 0;
+}
+
+/*!
+    \qmlmethod void NotificationQueue::enqueue(Notification notification)
+
+    Adds \a notification to the next batch. A notification already in the batch is published once,
+    with its content at the time the batch is published.
+*/
+/*!
+    \fn NotificationQueue::enqueue(Notification *notification)
+
+    Adds \a notification to the next batch. A notification already in the batch is published once,
+    with its content at the time the batch is published.
+ */
+void NotificationQueue::enqueue(Notification *notification)
+{
+    if (!notification || m_pending.contains(notification)) {
+        return;
+    }
+
+    m_pending.append(notification);
+    if (m_autoFlush && !m_timer.isActive()) {
+        m_timer.start();
+    }
+    emit pendingChanged();
+}
+
+/*!
+    \qmlmethod void NotificationQueue::flush()
+
+    Publishes the enqueued notifications now.
+*/
+/*!
+    \fn NotificationQueue::flush()
+
+    Publishes the enqueued notifications now.
+ */
+void NotificationQueue::flush()
+{
+    m_timer.stop();
+    if (m_pending.isEmpty()) {
+        return;
+    }
+
+    const QList<QPointer<Notification> > notifications(m_pending);
+    m_pending.clear();
+    emit pendingChanged();
+
+    const bool wasActive = active();
+    for (const QPointer<Notification> &notification : notifications) {
+        if (!notification) {
+            continue;
+        }
+        // Each scheduled publication is reported to publishFinished(); the others were
+        // deferred into a group update or found to be unnecessary, and were not sent
+        ++m_outstanding;
+        if (!notification->publish(this)) {
+            --m_outstanding;
+        }
+    }
+
+    if (m_outstanding == 0) {
+        completeBatch();
+    } else if (!wasActive) {
+        emit activeChanged();
+    }
+}
+
+/*!
+    \qmlmethod void NotificationQueue::clear()
+
+    Discards the enqueued notifications without publishing them.
+*/
+/*!
+    \fn NotificationQueue::clear()
+
+    Discards the enqueued notifications without publishing them.
+ */
+void NotificationQueue::clear()
+{
+    m_timer.stop();
+    if (!m_pending.isEmpty()) {
+        m_pending.clear();
+        emit pendingChanged();
+    }
+}
+
+/*!
+    \qmlsignal NotificationQueue::finished(int published, int failed)
+
+    Emitted when every notification of the published batches has been handled,
+    with the number that were \a published and the number that \a failed.
+
+    Notifications that were not sent, such as unchanged duplicates, group members deferred
+    into a later summary update, updates superseded before being sent and those waiting for the
+    notification service to start, are not counted.
+*/
+/*!
+    \fn NotificationQueue::finished(int published, int failed)
+
+    Emitted when every notification of the published batches has been handled,
+    with the number that were \a published and the number that \a failed.
+
+    Notifications that were not sent, such as unchanged duplicates, group members deferred
+    into a later summary update, updates superseded before being sent and those waiting for the
+    notification service to start, are not counted.
+ */
+void NotificationQueue::publishFinished(PublishResult result)
+{
+    if (result == Published) {
+        ++m_published;
+    } else if (result == Failed) {
+        ++m_failed;
+    }
+
+    if (--m_outstanding == 0) {
+        emit activeChanged();
+        completeBatch();
+    }
+}
+
+void NotificationQueue::completeBatch()
+{
+    const int published = m_published;
+    const int failed = m_failed;
+    m_published = 0;
+    m_failed = 0;
+    emit finished(published, failed);
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef NOTIFICATIONQUEUE_H
+#define NOTIFICATIONQUEUE_H
+
+#include <notificationexport.h>
+
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+
+class Notification;
+class NotificationConnectionManager;
+
+class NEMO_QML_PLUGIN_NOTIFICATIONS_EXPORT NotificationQueue : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int interval READ interval WRITE setInterval NOTIFY intervalChanged)
+    Q_PROPERTY(bool autoFlush READ autoFlush WRITE setAutoFlush NOTIFY autoFlushChanged)
+    Q_PROPERTY(int pending READ pending NOTIFY pendingChanged)
+    Q_PROPERTY(bool active READ active NOTIFY activeChanged)
+
+public:
+    explicit NotificationQueue(QObject *parent = 0);
+    ~NotificationQueue();
+
+    int interval() const;
+    void setInterval(int milliseconds);
+
+    bool autoFlush() const;
+    void setAutoFlush(bool autoFlush);
+
+    int pending() const;
+    bool active() const;
+
+    Q_INVOKABLE void enqueue(Notification *notification);
+    Q_INVOKABLE void flush();
+    Q_INVOKABLE void clear();
+
+signals:
+    void intervalChanged();
+    void autoFlushChanged();
+    void pendingChanged();
+    void activeChanged();
+    void finished(int published, int failed);
+
+private:
+    friend class NotificationConnectionManager;
+
+    // Publications that were superseded, cancelled or queued until the service appears were not sent
+    enum PublishResult { Published, Failed, NotSent };
+
+    void publishFinished(PublishResult result);
+    void completeBatch();
+
+    QList<QPointer<Notification> > m_pending;
+    QTimer m_timer;
+    bool m_autoFlush;
+    int m_outstanding;
+    int m_published;
+    int m_failed;
+};
+
+#endif // NOTIFICATIONQUEUE_H
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef NOTIFICATIONTABLE_H
+#define NOTIFICATIONTABLE_H
+
+#include <notificationexport.h>
+
+#include <QMetaType>
+#include <QSharedDataPointer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class QDBusArgument;
+class QDBusConnection;
+class NotificationConnectionManager;
+class NotificationTable;
+class NotificationTablePrivate;
+
+NEMO_QML_PLUGIN_NOTIFICATIONS_EXPORT QDBusArgument &operator<<(QDBusArgument &, const NotificationTable &);
+NEMO_QML_PLUGIN_NOTIFICATIONS_EXPORT const QDBusArgument &operator>>(const QDBusArgument &, NotificationTable &);
+
+class NEMO_QML_PLUGIN_NOTIFICATIONS_EXPORT NotificationTable
+{
+public:
+    NotificationTable();
+    NotificationTable(const NotificationTable &other);
+    ~NotificationTable();
+
+    NotificationTable &operator=(const NotificationTable &other);
+
+    static NotificationTable notifications(const QString &owner);
+    static NotificationTable notifications(const QString &owner, const QDBusConnection &bus);
+    static NotificationTable notificationsByCategory(const QString &category);
+    static NotificationTable notificationsByCategory(const QString &category, const QDBusConnection &bus);
+
+    int count() const;
+    bool isEmpty() const;
+
+    const QVector<uint> &ids() const;
+    const QVector<int> &urgencies() const;
+    const QVector<qint64> &timestamps() const;
+    const QVector<int> &itemCounts() const;
+
+    const QVector<int> &categoryIndices() const;
+    const QStringList &categories() const;
+    QString category(int row) const;
+
+    const QVector<int> &ownerIndices() const;
+    const QStringList &owners() const;
+    QString owner(int row) const;
+
+    const QVector<int> &appNameIndices() const;
+    const QStringList &appNames() const;
+    QString appName(int row) const;
+
+    QVector<int> sortedByTimestamp(Qt::SortOrder order = Qt::DescendingOrder) const;
+    QVector<QVector<int> > groupedByCategory() const;
+
+private:
+    friend class NotificationConnectionManager;
+    friend const QDBusArgument &operator>>(const QDBusArgument &, NotificationTable &);
+
+    QSharedDataPointer<NotificationTablePrivate> d;
+};
+
+Q_DECLARE_METATYPE(NotificationTable)
+
+#endif // NOTIFICATIONTABLE_H
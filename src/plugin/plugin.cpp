@@ -32,11 +32,69 @@
 
 #include <QtGlobal>
 #include <QtQml>
+#include <QFutureWatcher>
+#include <QJSValue>
 #include <QQmlEngine>
 #include <QQmlExtensionPlugin>
 #include <QDebug>
 
 #include "notification.h"
+#include "notificationqueue.h"
+
+// Adds the QML forms of the asynchronous listings, which deliver their result to a callback
+class DeclarativeNotification : public Notification
+{
+    Q_OBJECT
+
+public:
+    explicit DeclarativeNotification(QObject *parent = 0)
+        : Notification(parent)
+    {
+    }
+
+    Q_INVOKABLE void notificationsAsync(const QString &owner, const QJSValue &callback)
+    {
+        // The request is not started unless its result can be delivered
+        if (checkCallback(callback)) {
+            deliver(Notification::notificationsAsync(owner), callback);
+        }
+    }
+
+    Q_INVOKABLE void notificationsByCategoryAsync(const QString &category, const QJSValue &callback)
+    {
+        if (checkCallback(callback)) {
+            deliver(Notification::notificationsByCategoryAsync(category), callback);
+        }
+    }
+
+private:
+    static bool checkCallback(const QJSValue &callback)
+    {
+        if (!callback.isCallable()) {
+            qWarning() << "Notification listing callback is not a function";
+            return false;
+        }
+        return true;
+    }
+
+    void deliver(const QFuture<QList<QObject *> > &future, const QJSValue &callback)
+    {
+        QFutureWatcher<QList<QObject *> > *watcher = new QFutureWatcher<QList<QObject *> >(this);
+        connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, callback]() {
+            watcher->deleteLater();
+            const QList<QObject *> notifications(watcher->result());
+            QQmlEngine *engine = qmlEngine(this);
+            if (!engine) {
+                // Nothing can take ownership of the results
+                qDeleteAll(notifications);
+                return;
+            }
+            QJSValue function(callback);
+            function.call(QJSValueList() << engine->toScriptValue(notifications));
+        });
+        watcher->setFuture(future);
+    }
+};
 
 class Q_DECL_EXPORT NemoNotificationsPlugin : public QQmlExtensionPlugin
 {
@@ -59,7 +117,8 @@ public:
         if (uri == QLatin1String("org.nemomobile.notifications")) {
             qWarning() << "org.nemomobile.notifications import is deprecated. Suggest migrating to Nemo.Notifications";
         }
-        qmlRegisterType<Notification>(uri, 1, 0, "Notification");
+        qmlRegisterType<DeclarativeNotification>(uri, 1, 0, "Notification");
+        qmlRegisterType<NotificationQueue>(uri, 1, 0, "NotificationQueue");
     }
 };
 
@@ -6,11 +6,27 @@ CONFIG += qt hide_symbols create_pc create_prl
 QT += dbus
 
 SOURCES += notification.cpp \
+    notificationduplicatefilter.cpp \
+    notificationgroups.cpp \
+    notificationlistingcache.cpp \
+    notificationofflinequeue.cpp \
+    notificationpublishscheduler.cpp \
+    notificationpublishstatistics.cpp \
+    notificationqueue.cpp \
     notificationmanagerproxy.cpp
 
 HEADERS += \
     notification.h \
     notification_p.h \
+    notificationduplicatefilter_p.h \
+    notificationgroups_p.h \
+    notificationhints_p.h \
+    notificationlistingcache_p.h \
+    notificationofflinequeue_p.h \
+    notificationpublishscheduler_p.h \
+    notificationpublishstatistics_p.h \
+    notificationqueue.h \
+    notificationtable.h \
     notificationmanagerproxy.h \
     notificationexport.h
 
@@ -19,7 +35,7 @@ DEFINES += BUILD_NEMO_QML_PLUGIN_NOTIFICATIONS_LIB
 target.path = $$[QT_INSTALL_LIBS]
 pkgconfig.files = $$TARGET.pc
 pkgconfig.path = $$target.path/pkgconfig
-headers.files = notification.h notification_p.h notificationexport.h
+headers.files = notification.h notificationqueue.h notificationtable.h notificationexport.h
 headers.path = /usr/include/nemonotifications-qt$${QT_MAJOR_VERSION}
 
 QMAKE_PKGCONFIG_NAME = lib$$TARGET
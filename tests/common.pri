@@ -0,0 +1,13 @@
+TEMPLATE = app
+CONFIG += testcase
+QT += testlib dbus
+
+INCLUDEPATH += $$PWD/../src $$PWD/common
+DEPENDPATH += $$PWD/../src
+LIBS += -L$$OUT_PWD/../../src -lnemonotifications-qt$${QT_MAJOR_VERSION}
+
+HEADERS += $$PWD/common/mocknotificationserver.h
+SOURCES += $$PWD/common/mocknotificationserver.cpp
+
+target.path = /opt/tests/nemo-qml-plugin-notifications-qt$${QT_MAJOR_VERSION}
+INSTALLS += target
@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+
+#include "mocknotificationserver.h"
+
+#include <notification.h>
+
+#include <QDBusMessage>
+#include <QDBusMetaType>
+#include <QDBusServer>
+#include <QElapsedTimer>
+#include <QTimer>
+
+namespace {
+
+const QString HINT_CATEGORY = QStringLiteral("category");
+const QString HINT_OWNER = QStringLiteral("x-nemo-owner");
+const QString DBUS_PATH = QStringLiteral("/org/freedesktop/Notifications");
+
+}
+
+MockNotificationService::MockNotificationService(QObject *parent)
+    : QObject(parent)
+{
+    qDBusRegisterMetaType<NotificationData>();
+    qDBusRegisterMetaType<QList<NotificationData> >();
+}
+
+void MockNotificationService::setReplyDelay(int milliseconds)
+{
+    QMutexLocker locker(&m_mutex);
+    m_replyDelay = milliseconds;
+}
+
+void MockNotificationService::setCapabilities(const QStringList &capabilities)
+{
+    QMutexLocker locker(&m_mutex);
+    m_capabilities = capabilities;
+}
+
+QList<NotificationData> MockNotificationService::notifications() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_notifications.values();
+}
+
+NotificationData MockNotificationService::notification(uint id) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_notifications.value(id);
+}
+
+QList<NotificationData> MockNotificationService::published() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_published;
+}
+
+int MockNotificationService::callCount(const QString &method) const
+{
+    QMutexLocker locker(&m_mutex);
+    if (!method.isEmpty()) {
+        return m_calls.value(method);
+    }
+    int count = 0;
+    for (int calls : m_calls) {
+        count += calls;
+    }
+    return count;
+}
+
+int MockNotificationService::connectionCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_connections.count();
+}
+
+void MockNotificationService::reset()
+{
+    QMutexLocker locker(&m_mutex);
+    m_notifications.clear();
+    m_published.clear();
+    m_calls.clear();
+    m_capabilities.clear();
+    m_replyDelay = 0;
+}
+
+uint MockNotificationService::insert(const NotificationData &data)
+{
+    QMutexLocker locker(&m_mutex);
+    NotificationData inserted(data);
+    inserted.setReplacesId(++m_lastId);
+    m_notifications.insert(inserted.replacesId(), inserted);
+    return inserted.replacesId();
+}
+
+void MockNotificationService::addConnection(const QDBusConnection &connection)
+{
+    QDBusConnection conn(connection);
+    conn.registerObject(DBUS_PATH, this, QDBusConnection::ExportAllSlots | QDBusConnection::ExportAllSignals);
+
+    QMutexLocker locker(&m_mutex);
+    m_connections.append(conn);
+}
+
+void MockNotificationService::emitClosed(const QString &owner, uint id, uint reason)
+{
+    bool ownerSignals;
+    {
+        QMutexLocker locker(&m_mutex);
+        ownerSignals = m_capabilities.contains(QStringLiteral("x-nemo-owner-signals"));
+    }
+    emit NotificationClosed(id, reason);
+    if (ownerSignals) {
+        emit OwnerNotificationClosed(owner, id, reason);
+    }
+}
+
+void MockNotificationService::countCall(const QString &method)
+{
+    QMutexLocker locker(&m_mutex);
+    ++m_calls[method];
+}
+
+QStringList MockNotificationService::GetCapabilities()
+{
+    countCall(QStringLiteral("GetCapabilities"));
+    QMutexLocker locker(&m_mutex);
+    return m_capabilities;
+}
+
+uint MockNotificationService::Notify(const QString &appName, uint replacesId, const QString &appIcon, const QString &summary,
+                                     const QString &body, const QStringList &actions, const QVariantMap &hints, int expireTimeout)
+{
+    countCall(QStringLiteral("Notify"));
+
+    NotificationData data;
+    data.setAppName(appName);
+    data.setAppIcon(appIcon);
+    data.setSummary(summary);
+    data.setBody(body);
+    QList<NotificationData::ActionInfo> actionInfo;
+    for (int i = 0; i + 1 < actions.count(); i += 2) {
+        NotificationData::ActionInfo info;
+        info.name = actions.at(i);
+        info.displayName = actions.at(i + 1);
+        actionInfo.append(info);
+    }
+    data.setActions(actionInfo);
+    for (QVariantMap::const_iterator it = hints.constBegin(); it != hints.constEnd(); ++it) {
+        data.setHint(it.key(), it.value());
+    }
+    data.setExpireTimeout(expireTimeout);
+
+    int delay;
+    uint id;
+    {
+        QMutexLocker locker(&m_mutex);
+        id = m_notifications.contains(replacesId) ? replacesId : ++m_lastId;
+        data.setReplacesId(id);
+        m_notifications.insert(id, data);
+        m_published.append(data);
+        delay = m_replyDelay;
+    }
+
+    if (delay > 0) {
+        setDelayedReply(true);
+        const QDBusMessage reply(message().createReply(id));
+        QDBusConnection conn(connection());
+        QTimer::singleShot(delay, this, [conn, reply]() mutable {
+            conn.send(reply);
+        });
+    }
+    return id;
+}
+
+void MockNotificationService::close(const QList<uint> &ids)
+{
+    bool ownerSignals;
+    QStringList owners;
+    {
+        QMutexLocker locker(&m_mutex);
+        ownerSignals = m_capabilities.contains(QStringLiteral("x-nemo-owner-signals"));
+        for (uint id : ids) {
+            owners.append(m_notifications.take(id).hints().value(HINT_OWNER).toString());
+        }
+    }
+    for (int i = 0; i < ids.count(); ++i) {
+        emit NotificationClosed(ids.at(i), Notification::Closed);
+        if (ownerSignals) {
+            emit OwnerNotificationClosed(owners.at(i), ids.at(i), Notification::Closed);
+        }
+    }
+}
+
+void MockNotificationService::CloseNotification(uint id)
+{
+    countCall(QStringLiteral("CloseNotification"));
+    if (notification(id).replacesId() == id) {
+        close(QList<uint>() << id);
+    }
+}
+
+QString MockNotificationService::GetServerInformation(QString &name, QString &vendor, QString &version)
+{
+    countCall(QStringLiteral("GetServerInformation"));
+    name = QStringLiteral("mocknotificationserver");
+    vendor = QStringLiteral("nemo");
+    version = QStringLiteral("1.2");
+    return QString();
+}
+
+QList<NotificationData> MockNotificationService::listing(const QString &hint, const QString &value) const
+{
+    QMutexLocker locker(&m_mutex);
+    QList<NotificationData> rv;
+    for (const NotificationData &data : m_notifications) {
+        if (data.hints().value(hint).toString() == value) {
+            rv.append(data);
+        }
+    }
+    return rv;
+}
+
+QList<NotificationData> MockNotificationService::GetNotifications(const QString &owner)
+{
+    countCall(QStringLiteral("GetNotifications"));
+    return listing(HINT_OWNER, owner);
+}
+
+QList<NotificationData> MockNotificationService::GetNotificationsByCategory(const QString &category)
+{
+    countCall(QStringLiteral("GetNotificationsByCategory"));
+    return listing(HINT_CATEGORY, category);
+}
+
+void MockNotificationService::CloseNotifications(const QString &owner)
+{
+    countCall(QStringLiteral("CloseNotifications"));
+    QList<uint> ids;
+    for (const NotificationData &data : listing(HINT_OWNER, owner)) {
+        ids.append(data.replacesId());
+    }
+    close(ids);
+}
+
+void MockNotificationService::CloseNotificationsByCategory(const QString &category)
+{
+    countCall(QStringLiteral("CloseNotificationsByCategory"));
+    QList<uint> ids;
+    for (const NotificationData &data : listing(HINT_CATEGORY, category)) {
+        ids.append(data.replacesId());
+    }
+    close(ids);
+}
+
+void MockNotificationService::UpdateNotificationHints(uint id, const QVariantMap &hints)
+{
+    countCall(QStringLiteral("UpdateNotificationHints"));
+    QMutexLocker locker(&m_mutex);
+    QHash<uint, NotificationData>::iterator it = m_notifications.find(id);
+    if (it != m_notifications.end()) {
+        for (QVariantMap::const_iterator hint = hints.constBegin(); hint != hints.constEnd(); ++hint) {
+            it.value().setHint(hint.key(), hint.value());
+        }
+    }
+}
+
+MockNotificationServer::MockNotificationServer()
+{
+    start();
+    m_started.acquire();
+}
+
+MockNotificationServer::~MockNotificationServer()
+{
+    quit();
+    wait();
+}
+
+MockNotificationService *MockNotificationServer::service() const
+{
+    return m_service;
+}
+
+QDBusConnection MockNotificationServer::connectClient(const QString &name)
+{
+    const int connections = m_service->connectionCount();
+    QDBusConnection conn(QDBusConnection::connectToPeer(m_address, name));
+
+    QElapsedTimer timer;
+    timer.start();
+    while (m_service->connectionCount() == connections && !timer.hasExpired(5000)) {
+        QThread::msleep(1);
+    }
+    return conn;
+}
+
+void MockNotificationServer::run()
+{
+    QDBusServer server;
+    MockNotificationService service;
+    QObject::connect(&server, &QDBusServer::newConnection, &service, &MockNotificationService::addConnection);
+    m_service = &service;
+    m_address = server.address();
+    m_started.release();
+
+    exec();
+
+    m_service = nullptr;
+}
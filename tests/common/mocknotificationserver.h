@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+
+#ifndef MOCKNOTIFICATIONSERVER_H
+#define MOCKNOTIFICATIONSERVER_H
+
+#include <notification_p.h>
+
+#include <QDBusConnection>
+#include <QDBusContext>
+#include <QHash>
+#include <QMutex>
+#include <QSemaphore>
+#include <QStringList>
+#include <QThread>
+
+class QDBusServer;
+
+// An org.freedesktop.Notifications service, registered on every peer connection to a
+// MockNotificationServer. Its slots run on the server's thread; the accessors may be
+// called from any thread
+class MockNotificationService : public QObject, protected QDBusContext
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.Notifications")
+
+public:
+    explicit MockNotificationService(QObject *parent = 0);
+
+    // Notify replies are delayed by this many milliseconds, to hold publications in flight
+    void setReplyDelay(int milliseconds);
+    void setCapabilities(const QStringList &capabilities);
+
+    QList<NotificationData> notifications() const;
+    NotificationData notification(uint id) const;
+    // Every publication received, in order of arrival
+    QList<NotificationData> published() const;
+    int callCount(const QString &method = QString()) const;
+    int connectionCount() const;
+    void reset();
+    // Adds a notification as though it had been published by another client
+    uint insert(const NotificationData &data);
+
+    // Emits the closure signals for a notification, as though the server had closed it
+    Q_INVOKABLE void emitClosed(const QString &owner, uint id, uint reason);
+
+    void addConnection(const QDBusConnection &connection);
+
+public slots:
+    QStringList GetCapabilities();
+    uint Notify(const QString &appName, uint replacesId, const QString &appIcon, const QString &summary,
+                const QString &body, const QStringList &actions, const QVariantMap &hints, int expireTimeout);
+    void CloseNotification(uint id);
+    QString GetServerInformation(QString &name, QString &vendor, QString &version);
+    QList<NotificationData> GetNotifications(const QString &owner);
+    QList<NotificationData> GetNotificationsByCategory(const QString &category);
+    void CloseNotifications(const QString &owner);
+    void CloseNotificationsByCategory(const QString &category);
+    void UpdateNotificationHints(uint id, const QVariantMap &hints);
+
+signals:
+    void NotificationClosed(uint id, uint reason);
+    void ActionInvoked(uint id, const QString &actionKey);
+    void InputTextSet(uint id, const QString &input);
+    void OwnerNotificationClosed(const QString &owner, uint id, uint reason);
+    void OwnerActionInvoked(const QString &owner, uint id, const QString &actionKey);
+    void OwnerInputTextSet(const QString &owner, uint id, const QString &input);
+
+private:
+    void countCall(const QString &method);
+    void close(const QList<uint> &ids);
+    QList<NotificationData> listing(const QString &hint, const QString &value) const;
+
+    mutable QMutex m_mutex;
+    QHash<uint, NotificationData> m_notifications;
+    QList<NotificationData> m_published;
+    QHash<QString, int> m_calls;
+    QList<QDBusConnection> m_connections;
+    QStringList m_capabilities;
+    uint m_lastId = 0;
+    int m_replyDelay = 0;
+};
+
+// A p2p D-Bus server on its own thread, so that clients may make blocking calls to it
+class MockNotificationServer : public QThread
+{
+    Q_OBJECT
+
+public:
+    MockNotificationServer();
+    ~MockNotificationServer();
+
+    MockNotificationService *service() const;
+
+    // Returns a connection to the server, once the service is registered on it. Each
+    // name has its own connection, and so its own connection manager in the library
+    QDBusConnection connectClient(const QString &name);
+
+protected:
+    void run() override;
+
+private:
+    MockNotificationService *m_service = nullptr;
+    QString m_address;
+    QSemaphore m_started;
+};
+
+#endif // MOCKNOTIFICATIONSERVER_H
@@ -0,0 +1,12 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    ut_connectionhelpers \
+    ut_notification \
+    ut_notificationdata
+
+tests_xml.files = tests.xml
+tests_xml.path = /opt/tests/nemo-qml-plugin-notifications-qt$${QT_MAJOR_VERSION}
+INSTALLS += tests_xml
+
+OTHER_FILES += tests.xml
@@ -0,0 +1,575 @@
+/*
+ * Copyright (C) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+
+#include <notification.h>
+#include <notificationduplicatefilter_p.h>
+#include <notificationgroups_p.h>
+#include <notificationofflinequeue_p.h>
+#include <notificationpublishscheduler_p.h>
+
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+
+#include <QtTest>
+
+#include <algorithm>
+
+class ut_connectionhelpers : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void offlineQueuePersistence();
+    void offlineQueueSupersedes();
+    void offlineQueueLimit();
+    void offlineQueueDraining();
+
+    void groupItemCounts();
+    void groupPendingUpdates();
+    void groupSummaryRemoved();
+
+    void duplicatesSkipped();
+    void duplicateTimestampsRefreshed();
+    void duplicateDigestsForgotten();
+
+    void schedulerOrdering();
+    void schedulerMergesUpdates();
+    void schedulerCancels();
+
+private:
+    static NotificationData createData(const QString &summary, uint replacesId = 0,
+                                       const QString &category = QString());
+    static NotificationData createMember(int itemCount);
+    ScheduledPublish createPublish(const QString &summary, Notification *notification, int urgency);
+    QDBusPendingCallWatcher *createWatcher();
+    QStringList sendAll(NotificationPublishScheduler *scheduler, QHash<QString, QDBusPendingCallWatcher *> *calls);
+    static QStringList summaries(const QString &path);
+};
+
+NotificationData ut_connectionhelpers::createData(const QString &summary, uint replacesId, const QString &category)
+{
+    NotificationData data;
+    data.setSummary(summary);
+    data.setReplacesId(replacesId);
+    if (!category.isEmpty()) {
+        data.setHint(QStringLiteral("category"), category);
+    }
+    return data;
+}
+
+NotificationData ut_connectionhelpers::createMember(int itemCount)
+{
+    NotificationData data(createData(QStringLiteral("member")));
+    data.setHint(QStringLiteral("x-nemo-item-count"), itemCount);
+    data.setHint(QStringLiteral("x-nemo-owner"), QStringLiteral("owner"));
+    return data;
+}
+
+ScheduledPublish ut_connectionhelpers::createPublish(const QString &summary, Notification *notification, int urgency)
+{
+    ScheduledPublish entry;
+    entry.data = createData(summary);
+    entry.notification = notification;
+    entry.urgency = urgency;
+    return entry;
+}
+
+QDBusPendingCallWatcher *ut_connectionhelpers::createWatcher()
+{
+    // Only the identity of the watcher matters to the scheduler
+    return new QDBusPendingCallWatcher(QDBusPendingCall::fromCompletedCall(QDBusMessage()), this);
+}
+
+QStringList ut_connectionhelpers::sendAll(NotificationPublishScheduler *scheduler, QHash<QString, QDBusPendingCallWatcher *> *calls)
+{
+    QStringList sent;
+    ScheduledPublish entry;
+    while (scheduler->takeNext(&entry)) {
+        QDBusPendingCallWatcher *watcher = createWatcher();
+        scheduler->sent(watcher, entry);
+        calls->insert(entry.data.summary(), watcher);
+        sent.append(entry.data.summary());
+    }
+    return sent;
+}
+
+QStringList ut_connectionhelpers::summaries(const QString &path)
+{
+    QStringList rv;
+    QFile file(path);
+    QList<NotificationData> notifications;
+    if (file.open(QIODevice::ReadOnly) && NotificationDataCodec::decode(file.readAll(), &notifications)) {
+        for (const NotificationData &data : notifications) {
+            rv.append(data.summary());
+        }
+    }
+    return rv;
+}
+
+void ut_connectionhelpers::offlineQueuePersistence()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path(dir.path() + QStringLiteral("/queue/offline.bin"));
+
+    {
+        NotificationOfflineQueue queue;
+        queue.setLimit(10);
+        queue.setFile(path);
+        queue.enqueue(createData(QStringLiteral("first"), 0, QStringLiteral("x-nemo.a")), nullptr);
+        queue.enqueue(createData(QStringLiteral("second"), 7), nullptr);
+        QCOMPARE(summaries(path), QStringList() << QStringLiteral("first") << QStringLiteral("second"));
+    }
+
+    // A new queue restores what was saved, whatever its limit
+    NotificationOfflineQueue restored;
+    restored.setLimit(1);
+    restored.setFile(path);
+    QCOMPARE(restored.count(), 2);
+
+    const QueuedNotification first(restored.takeFirst());
+    QCOMPARE(first.data.summary(), QStringLiteral("first"));
+    QCOMPARE(first.data.hints().value(QStringLiteral("category")).toString(), QStringLiteral("x-nemo.a"));
+    const QueuedNotification second(restored.takeFirst());
+    QCOMPARE(second.data.summary(), QStringLiteral("second"));
+    QCOMPARE(second.data.replacesId(), 7u);
+
+    // The file is rewritten when the queue next changes, and removed once it is empty
+    restored.setLimit(1);
+    QVERIFY(!QFile::exists(path));
+}
+
+void ut_connectionhelpers::offlineQueueSupersedes()
+{
+    Notification notification;
+
+    NotificationOfflineQueue queue;
+    queue.setLimit(10);
+    queue.enqueue(createData(QStringLiteral("one")), &notification);
+    queue.enqueue(createData(QStringLiteral("two"), 5), nullptr);
+    // The latest content of each notification replaces what was queued for it
+    queue.enqueue(createData(QStringLiteral("one, updated")), &notification);
+    queue.enqueue(createData(QStringLiteral("two, updated"), 5), nullptr);
+    QCOMPARE(queue.count(), 2);
+    QCOMPARE(queue.takeFirst().data.summary(), QStringLiteral("one, updated"));
+
+    // A failed entry returns to the front, unless it has been superseded in the meantime
+    QueuedNotification failed;
+    failed.data = createData(QStringLiteral("one, failed"));
+    failed.notification = &notification;
+    queue.requeue(failed);
+    QCOMPARE(queue.count(), 2);
+    QCOMPARE(queue.takeFirst().data.summary(), QStringLiteral("one, failed"));
+
+    failed.data = createData(QStringLiteral("two, failed"), 5);
+    failed.notification.clear();
+    queue.requeue(failed);
+    QCOMPARE(queue.count(), 1);
+    QCOMPARE(queue.takeFirst().data.summary(), QStringLiteral("two, updated"));
+
+    queue.enqueue(createData(QStringLiteral("cancelled")), &notification);
+    queue.cancel(&notification);
+    QVERIFY(queue.isEmpty());
+}
+
+void ut_connectionhelpers::offlineQueueLimit()
+{
+    NotificationOfflineQueue queue;
+    queue.setLimit(3);
+    queue.enqueue(createData(QStringLiteral("a1"), 0, QStringLiteral("a")), nullptr);
+    queue.enqueue(createData(QStringLiteral("b1"), 0, QStringLiteral("b")), nullptr);
+    queue.enqueue(createData(QStringLiteral("a2"), 0, QStringLiteral("a")), nullptr);
+
+    // The oldest entry in the same category is dropped
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression(QStringLiteral("queue full.*b1")));
+    queue.enqueue(createData(QStringLiteral("b2"), 0, QStringLiteral("b")), nullptr);
+    // Otherwise the oldest of all
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression(QStringLiteral("queue full.*a1")));
+    queue.enqueue(createData(QStringLiteral("c1"), 0, QStringLiteral("c")), nullptr);
+
+    QStringList remaining;
+    while (!queue.isEmpty()) {
+        remaining.append(queue.takeFirst().data.summary());
+    }
+    QCOMPARE(remaining, QStringList() << QStringLiteral("a2") << QStringLiteral("b2") << QStringLiteral("c1"));
+
+    // Lowering the limit drops the oldest entries
+    queue.enqueue(createData(QStringLiteral("x")), nullptr);
+    queue.enqueue(createData(QStringLiteral("y")), nullptr);
+    queue.setLimit(1);
+    QCOMPARE(queue.count(), 1);
+    QCOMPARE(queue.takeFirst().data.summary(), QStringLiteral("y"));
+}
+
+void ut_connectionhelpers::offlineQueueDraining()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path(dir.path() + QStringLiteral("/offline.bin"));
+
+    NotificationOfflineQueue queue;
+    queue.setLimit(10);
+    queue.setFile(path);
+    queue.enqueue(createData(QStringLiteral("first")), nullptr);
+    queue.enqueue(createData(QStringLiteral("second")), nullptr);
+
+    // Entries in flight stay in the file until the drain completes
+    queue.setDraining(true);
+    queue.takeFirst();
+    queue.enqueue(createData(QStringLiteral("third")), nullptr);
+    QCOMPARE(summaries(path), QStringList() << QStringLiteral("first") << QStringLiteral("second"));
+
+    queue.setDraining(false);
+    QCOMPARE(summaries(path), QStringList() << QStringLiteral("second") << QStringLiteral("third"));
+}
+
+void ut_connectionhelpers::groupItemCounts()
+{
+    Notification first;
+    Notification second;
+    const QString group(QStringLiteral("group"));
+
+    NotificationGroups groups;
+    groups.setWindow(0);
+
+    // The first member is published at once, as the summary
+    NotificationData data(createMember(2));
+    QVERIFY(!groups.bundle(group, &data, &first));
+    QCOMPARE(data.replacesId(), 0u);
+    QCOMPARE(data.hints().value(QStringLiteral("x-nemo-item-count")).toInt(), 2);
+    groups.published(group, 10);
+    QCOMPARE(groups.summaryId(group), 10u);
+
+    // Later members update it, with the accumulated count
+    data = createMember(3);
+    QVERIFY(!groups.bundle(group, &data, &second));
+    QCOMPARE(data.replacesId(), 10u);
+    QCOMPARE(data.hints().value(QStringLiteral("x-nemo-item-count")).toInt(), 5);
+    groups.published(group, 10);
+
+    // A member published again replaces its previous contribution
+    data = createMember(4);
+    QVERIFY(!groups.bundle(group, &data, &first));
+    QCOMPARE(data.hints().value(QStringLiteral("x-nemo-item-count")).toInt(), 7);
+    groups.published(group, 10);
+
+    // A member without a count contributes one item
+    Notification third;
+    data = createData(QStringLiteral("member"));
+    QVERIFY(!groups.bundle(group, &data, &third));
+    QCOMPARE(groups.itemCount(group), 8);
+
+    // A withdrawn member takes its items with it; a destroyed one leaves them in place
+    groups.removeMember(group, &second, true);
+    QCOMPARE(groups.itemCount(group), 5);
+    groups.removeMember(group, &third, false);
+    QCOMPARE(groups.itemCount(group), 5);
+
+    QCOMPARE(groups.idsWithOwner(QStringLiteral("owner")), QList<uint>());
+    QCOMPARE(groups.owners(), QStringList() << QString());
+    QCOMPARE(groups.collapsedUpdates(), 0ull);
+}
+
+void ut_connectionhelpers::groupPendingUpdates()
+{
+    Notification first;
+    Notification second;
+    Notification third;
+    const QString group(QStringLiteral("group"));
+
+    NotificationGroups groups;
+    groups.setWindow(60000);
+
+    NotificationData data(createMember(1));
+    QVERIFY(!groups.bundle(group, &data, &first));
+
+    // Until the first publication replies, the summary's ID is unknown, so updates are held
+    data = createMember(2);
+    QVERIFY(groups.bundle(group, &data, &second));
+    QCOMPARE(groups.flushDelay(group), -1ll);
+    groups.published(group, 20);
+    QVERIFY(groups.flushDelay(group) > 0);
+
+    // Updates within the window collapse into one
+    data = createMember(3);
+    QVERIFY(groups.bundle(group, &data, &third));
+    QCOMPARE(groups.collapsedUpdates(), 1ull);
+    QCOMPARE(groups.itemCount(group), 6);
+
+    // Nothing is due until the window closes
+    qint64 next = -1;
+    QVERIFY(groups.dueGroups(&next).isEmpty());
+    QVERIFY(next > 0);
+    groups.setWindow(0);
+    QCOMPARE(groups.dueGroups(&next), QStringList() << group);
+    QCOMPARE(next, -1ll);
+
+    QList<QPointer<Notification> > members;
+    QVERIFY(groups.takePending(group, &data, &members));
+    QCOMPARE(data.replacesId(), 20u);
+    QCOMPARE(data.hints().value(QStringLiteral("x-nemo-item-count")).toInt(), 6);
+    QCOMPARE(members.count(), 2);
+    QCOMPARE(members.at(0).data(), &second);
+    QCOMPARE(members.at(1).data(), &third);
+    QVERIFY(!groups.takePending(group, &data, &members));
+
+    // Once published, the next update waits for the window to close
+    groups.setWindow(60000);
+    data = createMember(1);
+    QVERIFY(groups.bundle(group, &data, &first));
+    QVERIFY(groups.flushDelay(group) > 0);
+    QVERIFY(groups.dueGroups(&next).isEmpty());
+    QVERIFY(next > 0);
+}
+
+void ut_connectionhelpers::groupSummaryRemoved()
+{
+    Notification first;
+    Notification second;
+    const QString group(QStringLiteral("group"));
+
+    NotificationGroups groups;
+    groups.setWindow(60000);
+
+    NotificationData data(createMember(2));
+    QVERIFY(!groups.bundle(group, &data, &first));
+    groups.published(group, 30);
+    QCOMPARE(groups.idsWithOwner(QStringLiteral("owner")), QList<uint>() << 30u);
+
+    // A pending member keeps the group when its summary is closed, and starts a new summary
+    data = createMember(4);
+    QVERIFY(groups.bundle(group, &data, &second));
+    QVERIFY(!groups.summaryRemoved(30));
+    QVERIFY(groups.contains(group));
+    QCOMPARE(groups.summaryId(group), 0u);
+    QCOMPARE(groups.itemCount(group), 4);
+
+    QList<QPointer<Notification> > members;
+    QVERIFY(groups.takePending(group, &data, &members));
+    QCOMPARE(data.replacesId(), 0u);
+    groups.published(group, 31);
+
+    // Without one, the group is forgotten
+    QVERIFY(groups.summaryRemoved(31));
+    QVERIFY(!groups.contains(group));
+    QVERIFY(groups.isEmpty());
+}
+
+void ut_connectionhelpers::duplicatesSkipped()
+{
+    NotificationDuplicateFilter filter;
+    filter.setPolicy(NotificationConnectionManager::SkipDuplicates);
+
+    // A new notification has nothing to duplicate, but its digest is still taken
+    NotificationData data(createData(QStringLiteral("summary"), 0, QStringLiteral("x-nemo.a")));
+    QByteArray digest;
+    QVERIFY(!filter.filter(&data, &digest));
+    QVERIFY(!digest.isEmpty());
+    filter.acknowledge(5, digest, data.hints());
+
+    // Republishing the same content under the ID it was given is skipped
+    data.setReplacesId(5);
+    QByteArray repeated;
+    QVERIFY(filter.filter(&data, &repeated));
+    QCOMPARE(repeated, digest);
+    QCOMPARE(filter.skipped(), 1ull);
+
+    // Any change is published
+    data.setBody(QStringLiteral("changed"));
+    QVERIFY(!filter.filter(&data, &repeated));
+    QVERIFY(repeated != digest);
+    data.setBody(QString());
+    data.setHint(QStringLiteral("x-nemo-item-count"), 2);
+    QVERIFY(!filter.filter(&data, &repeated));
+
+    // As is the same content for another ID
+    NotificationData other(createData(QStringLiteral("summary"), 6, QStringLiteral("x-nemo.a")));
+    QVERIFY(!filter.filter(&other, &repeated));
+    QCOMPARE(filter.skipped(), 1ull);
+    QCOMPARE(filter.refreshed(), 0ull);
+}
+
+void ut_connectionhelpers::duplicateTimestampsRefreshed()
+{
+    NotificationDuplicateFilter filter;
+    filter.setPolicy(NotificationConnectionManager::RefreshDuplicateTimestamp);
+
+    NotificationData data(createData(QStringLiteral("summary")));
+    data.setHint(QStringLiteral("x-nemo-timestamp"), QStringLiteral("2020-01-01T00:00:00Z"));
+    QByteArray digest;
+    QVERIFY(!filter.filter(&data, &digest));
+    filter.acknowledge(8, digest, data.hints());
+
+    // The timestamp is not part of the content, and is refreshed when the rest is repeated
+    data.setReplacesId(8);
+    data.setHint(QStringLiteral("x-nemo-timestamp"), QStringLiteral("2020-01-02T00:00:00Z"));
+    QVERIFY(!filter.filter(&data, &digest));
+    QCOMPARE(filter.refreshed(), 1ull);
+    const QDateTime timestamp(data.hints().value(QStringLiteral("x-nemo-timestamp")).toDateTime());
+    QVERIFY(timestamp > QDateTime(QDate(2020, 1, 2), QTime(0, 0), Qt::UTC));
+    QCOMPARE(filter.skipped(), 0ull);
+}
+
+void ut_connectionhelpers::duplicateDigestsForgotten()
+{
+    NotificationDuplicateFilter filter;
+    filter.setPolicy(NotificationConnectionManager::SkipDuplicates);
+
+    QByteArray digest;
+    NotificationData first(createData(QStringLiteral("first"), 1, QStringLiteral("x-nemo.a")));
+    first.setHint(QStringLiteral("x-nemo-owner"), QStringLiteral("owner"));
+    filter.filter(&first, &digest);
+    filter.acknowledge(1, digest, first.hints());
+    NotificationData second(createData(QStringLiteral("second"), 2, QStringLiteral("x-nemo.b")));
+    second.setHint(QStringLiteral("x-nemo-owner"), QStringLiteral("owner"));
+    filter.filter(&second, &digest);
+    filter.acknowledge(2, digest, second.hints());
+
+    QList<uint> ids(filter.idsWithOwner(QStringLiteral("owner")));
+    std::sort(ids.begin(), ids.end());
+    QCOMPARE(ids, QList<uint>() << 1u << 2u);
+    QCOMPARE(filter.idsWithCategory(QStringLiteral("x-nemo.b")), QList<uint>() << 2u);
+
+    // A removed notification is published again in full
+    filter.remove(1);
+    QVERIFY(!filter.filter(&first, &digest));
+    QVERIFY(filter.filter(&second, &digest));
+
+    // Digests taken under another policy are not compared
+    filter.setPolicy(NotificationConnectionManager::RefreshDuplicateTimestamp);
+    QVERIFY(!filter.filter(&second, &digest));
+    QCOMPARE(filter.refreshed(), 0ull);
+    QVERIFY(filter.idsWithOwner(QStringLiteral("owner")).isEmpty());
+}
+
+void ut_connectionhelpers::schedulerOrdering()
+{
+    Notification l1, l2, l3, c1;
+    QHash<QString, QDBusPendingCallWatcher *> calls;
+
+    NotificationPublishScheduler scheduler;
+    scheduler.setMaxInFlight(2);
+    scheduler.setReservedCritical(1);
+
+    scheduler.schedule(createPublish(QStringLiteral("L1"), &l1, Notification::Low));
+    QCOMPARE(sendAll(&scheduler, &calls), QStringList() << QStringLiteral("L1"));
+
+    // Less urgent updates are limited to the unreserved capacity, which L1 occupies
+    scheduler.schedule(createPublish(QStringLiteral("L2"), &l2, Notification::Low));
+    scheduler.schedule(createPublish(QStringLiteral("L3"), &l3, Notification::Low));
+    QVERIFY(sendAll(&scheduler, &calls).isEmpty());
+    QCOMPARE(scheduler.queueDepth(), 2);
+
+    // A critical update does not wait behind them
+    scheduler.schedule(createPublish(QStringLiteral("C1"), &c1, Notification::Critical));
+    QCOMPARE(sendAll(&scheduler, &calls), QStringList() << QStringLiteral("C1"));
+    QCOMPARE(scheduler.inFlight(), 2);
+
+    QCOMPARE(scheduler.finished(calls.value(QStringLiteral("L1")), 1).data.summary(), QStringLiteral("L1"));
+    QVERIFY(sendAll(&scheduler, &calls).isEmpty());
+    QCOMPARE(scheduler.finished(calls.value(QStringLiteral("C1")), 2).data.summary(), QStringLiteral("C1"));
+    QCOMPARE(sendAll(&scheduler, &calls), QStringList() << QStringLiteral("L2"));
+    scheduler.finished(calls.value(QStringLiteral("L2")), 3);
+    QCOMPARE(sendAll(&scheduler, &calls), QStringList() << QStringLiteral("L3"));
+    scheduler.finished(calls.value(QStringLiteral("L3")), 4);
+
+    QCOMPARE(scheduler.inFlight(), 0);
+    QCOMPARE(scheduler.queueDepth(), 0);
+    QCOMPARE(scheduler.peakQueueDepth(), 3);
+    QVERIFY(scheduler.maxWait(Notification::Low) >= scheduler.maxWait(Notification::Critical));
+}
+
+void ut_connectionhelpers::schedulerMergesUpdates()
+{
+    Notification notification;
+    QHash<QString, QDBusPendingCallWatcher *> calls;
+
+    NotificationPublishScheduler scheduler;
+    scheduler.setMaxInFlight(1);
+    scheduler.setReservedCritical(0);
+
+    // A queued update is replaced by a later one
+    scheduler.schedule(createPublish(QStringLiteral("first"), &notification, Notification::Normal));
+    scheduler.schedule(createPublish(QStringLiteral("second"), &notification, Notification::Normal));
+    QCOMPARE(scheduler.merged(), 1ull);
+    QCOMPARE(scheduler.queueDepth(), 1);
+    QCOMPARE(sendAll(&scheduler, &calls), QStringList() << QStringLiteral("second"));
+
+    // An update to a notification in flight is held until its ID is known
+    scheduler.schedule(createPublish(QStringLiteral("third"), &notification, Notification::Critical));
+    scheduler.schedule(createPublish(QStringLiteral("fourth"), &notification, Notification::Critical));
+    QCOMPARE(scheduler.merged(), 2ull);
+    QCOMPARE(scheduler.queueDepth(), 1);
+    QVERIFY(sendAll(&scheduler, &calls).isEmpty());
+
+    scheduler.finished(calls.value(QStringLiteral("second")), 42);
+    ScheduledPublish next;
+    QVERIFY(scheduler.takeNext(&next));
+    QCOMPARE(next.data.summary(), QStringLiteral("fourth"));
+    QCOMPARE(next.data.replacesId(), 42u);
+}
+
+void ut_connectionhelpers::schedulerCancels()
+{
+    Notification sent, queued, other;
+    QHash<QString, QDBusPendingCallWatcher *> calls;
+
+    NotificationPublishScheduler scheduler;
+    scheduler.setMaxInFlight(1);
+    scheduler.setReservedCritical(0);
+
+    scheduler.schedule(createPublish(QStringLiteral("sent"), &sent, Notification::Normal));
+    QCOMPARE(sendAll(&scheduler, &calls), QStringList() << QStringLiteral("sent"));
+    scheduler.schedule(createPublish(QStringLiteral("held"), &sent, Notification::Normal));
+    scheduler.schedule(createPublish(QStringLiteral("queued"), &queued, Notification::Normal));
+    scheduler.schedule(createPublish(QStringLiteral("other"), &other, Notification::Normal));
+
+    QList<ScheduledPublish> removed;
+    QList<ScheduledPublish> held;
+    scheduler.cancel(&sent, &removed, &held);
+    QVERIFY(removed.isEmpty());
+    QCOMPARE(held.count(), 1);
+    QCOMPARE(held.first().data.summary(), QStringLiteral("held"));
+
+    held.clear();
+    scheduler.cancel(&queued, &removed, &held);
+    QCOMPARE(removed.count(), 1);
+    QCOMPARE(removed.first().data.summary(), QStringLiteral("queued"));
+    QVERIFY(held.isEmpty());
+
+    // A publication already sent cannot be recalled, but is marked so that its result is discarded
+    const ScheduledPublish finished(scheduler.finished(calls.value(QStringLiteral("sent")), 7));
+    QVERIFY(finished.cancelled);
+    QCOMPARE(sendAll(&scheduler, &calls), QStringList() << QStringLiteral("other"));
+}
+
+QTEST_GUILESS_MAIN(ut_connectionhelpers)
+
+#include "ut_connectionhelpers.moc"
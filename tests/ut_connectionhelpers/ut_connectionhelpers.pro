@@ -0,0 +1,4 @@
+include(../common.pri)
+
+TARGET = ut_connectionhelpers
+SOURCES += ut_connectionhelpers.cpp
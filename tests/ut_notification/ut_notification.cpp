@@ -0,0 +1,578 @@
+/*
+ * Copyright (C) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+
+#include "mocknotificationserver.h"
+
+#include <notification.h>
+
+#include <QtTest>
+
+namespace {
+
+class NotificationCreator : public QRunnable
+{
+public:
+    NotificationCreator(int index, QString *result)
+        : m_index(index)
+        , m_result(result)
+    {
+    }
+
+    void run() override
+    {
+        for (int i = 0; i < 100; ++i) {
+            Notification notification;
+            notification.setAppName(QStringLiteral("app-%1").arg(i % 4));
+            notification.setAppIcon(QStringLiteral("icon-%1").arg(m_index));
+            if (notification.appName() != QStringLiteral("app-%1").arg(i % 4)) {
+                *m_result = notification.appName();
+                return;
+            }
+        }
+        *m_result = QStringLiteral("ok");
+    }
+
+private:
+    int m_index;
+    QString *m_result;
+};
+
+}
+
+class ut_notification : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+
+    void hintsForProperties();
+    void propertiesFromListing();
+    void benchmarkPropertyReads();
+    void benchmarkHintWrites();
+
+    void idleDefaults();
+    void signalsDeliveredById();
+    void internAcrossThreads();
+    void benchmarkIdleConstruction();
+    void constructionWithoutBusActivity();
+    void benchmarkBoundConstruction();
+
+    void groupedSummary();
+    void duplicatePublishesSkipped();
+
+    void publishOrdering();
+
+    void ownerSignalsFiltered();
+    void benchmarkForeignSignals_data();
+    void benchmarkForeignSignals();
+    void benchmarkCriticalUnderFlood();
+
+private:
+    QDBusConnection newConnection();
+    QString owner() const;
+
+    MockNotificationServer *m_server = nullptr;
+    int m_connections = 0;
+};
+
+void ut_notification::initTestCase()
+{
+    m_server = new MockNotificationServer;
+}
+
+void ut_notification::cleanupTestCase()
+{
+    delete m_server;
+}
+
+void ut_notification::init()
+{
+    m_server->service()->reset();
+}
+
+QDBusConnection ut_notification::newConnection()
+{
+    // A new connection has a new connection manager, so no state is carried between tests
+    const QDBusConnection conn(m_server->connectClient(QStringLiteral("ut_notification-%1").arg(++m_connections)));
+    if (!conn.isConnected()) {
+        qWarning() << "Unable to connect to the mock notification server:" << conn.lastError().message();
+    }
+    return conn;
+}
+
+QString ut_notification::owner() const
+{
+    return QCoreApplication::applicationName();
+}
+
+void ut_notification::hintsForProperties()
+{
+    const QDateTime timestamp(QDate(2020, 4, 1), QTime(12, 30), Qt::UTC);
+
+    Notification notification;
+    QVERIFY(notification.setDBusConnection(newConnection()));
+    notification.setAppName(QStringLiteral("ut"));
+    notification.setSummary(QStringLiteral("summary"));
+    notification.setBody(QStringLiteral("body"));
+    notification.setCategory(QStringLiteral("x-nemo.test"));
+    notification.setItemCount(3);
+    notification.setTimestamp(timestamp);
+    notification.setUrgency(Notification::Critical);
+    notification.publish();
+    QVERIFY(notification.replacesId() != 0);
+
+    const NotificationData data(m_server->service()->notification(notification.replacesId()));
+    QCOMPARE(data.appName(), QStringLiteral("ut"));
+    QCOMPARE(data.summary(), QStringLiteral("summary"));
+    QCOMPARE(data.body(), QStringLiteral("body"));
+
+    const QVariantHash &hints(data.hints());
+    QCOMPARE(hints.value(QStringLiteral("category")).toString(), QStringLiteral("x-nemo.test"));
+    QCOMPARE(hints.value(QStringLiteral("x-nemo-item-count")).toInt(), 3);
+    QCOMPARE(hints.value(QStringLiteral("x-nemo-timestamp")).toDateTime(), timestamp);
+    QCOMPARE(hints.value(QStringLiteral("urgency")).toInt(), static_cast<int>(Notification::Critical));
+    QCOMPARE(hints.value(QStringLiteral("x-nemo-owner")).toString(), owner());
+    // The preview defaults to the summary and body
+    QCOMPARE(hints.value(QStringLiteral("x-nemo-preview-summary")).toString(), QStringLiteral("summary"));
+    QCOMPARE(hints.value(QStringLiteral("x-nemo-preview-body")).toString(), QStringLiteral("body"));
+}
+
+void ut_notification::propertiesFromListing()
+{
+    const QDBusConnection conn(newConnection());
+
+    Notification notification;
+    QVERIFY(notification.setDBusConnection(conn));
+    notification.setSummary(QStringLiteral("listed"));
+    notification.setCategory(QStringLiteral("x-nemo.listed"));
+    notification.setItemCount(5);
+    notification.setUrgency(Notification::Low);
+    notification.publish();
+    QVERIFY(notification.replacesId() != 0);
+
+    const QList<QObject *> listed(Notification::notifications(owner(), conn));
+    QCOMPARE(listed.count(), 1);
+
+    const Notification *copy = qobject_cast<Notification *>(listed.first());
+    QVERIFY(copy);
+    QCOMPARE(copy->replacesId(), notification.replacesId());
+    QCOMPARE(copy->summary(), notification.summary());
+    QCOMPARE(copy->category(), notification.category());
+    QCOMPARE(copy->itemCount(), 5);
+    QCOMPARE(copy->urgency(), Notification::Low);
+    qDeleteAll(listed);
+}
+
+void ut_notification::benchmarkPropertyReads()
+{
+    Notification notification;
+    notification.setCategory(QStringLiteral("x-nemo.test"));
+    notification.setItemCount(3);
+    notification.setTimestamp(QDateTime::currentDateTimeUtc());
+    notification.setUrgency(Notification::Normal);
+    notification.setPreviewSummary(QStringLiteral("preview"));
+
+    int total = 0;
+    QBENCHMARK {
+        total += notification.category().size();
+        total += notification.itemCount();
+        total += notification.urgency();
+        total += notification.previewSummary().size();
+        total += notification.timestamp().isValid() ? 1 : 0;
+    }
+    QVERIFY(total > 0);
+}
+
+void ut_notification::benchmarkHintWrites()
+{
+    Notification notification;
+    int count = 0;
+    QBENCHMARK {
+        notification.setItemCount(++count);
+        notification.setUrgency(count & 1 ? Notification::Normal : Notification::Low);
+        notification.setHintValue(QStringLiteral("x-nemo-progress"), count);
+    }
+    QCOMPARE(notification.itemCount(), count);
+}
+
+void ut_notification::idleDefaults()
+{
+    Notification notification;
+    QCOMPARE(notification.replacesId(), 0u);
+    QCOMPARE(notification.urgency(), Notification::Normal);
+    QCOMPARE(notification.hintValue(QStringLiteral("urgency")).toInt(), static_cast<int>(Notification::Normal));
+    QCOMPARE(notification.expireTimeout(), -1);
+    QVERIFY(notification.remoteActions().isEmpty());
+
+    // Modifying one notification does not affect the defaults shared with others
+    notification.setUrgency(Notification::Critical);
+    Notification other;
+    QCOMPARE(other.urgency(), Notification::Normal);
+}
+
+void ut_notification::signalsDeliveredById()
+{
+    const QDBusConnection conn(newConnection());
+
+    Notification first;
+    Notification second;
+    Notification unpublished;
+    for (Notification *notification : { &first, &second, &unpublished }) {
+        QVERIFY(notification->setDBusConnection(conn));
+        notification->setSummary(QStringLiteral("signals"));
+    }
+    first.publish();
+    second.publish();
+    QVERIFY(first.replacesId() != 0);
+    QVERIFY(second.replacesId() != 0);
+
+    QSignalSpy firstClosed(&first, SIGNAL(closed(uint)));
+    QSignalSpy secondClosed(&second, SIGNAL(closed(uint)));
+    QSignalSpy unpublishedClosed(&unpublished, SIGNAL(closed(uint)));
+
+    QMetaObject::invokeMethod(m_server->service(), "emitClosed", Qt::QueuedConnection,
+                              Q_ARG(QString, owner()), Q_ARG(uint, first.replacesId()),
+                              Q_ARG(uint, static_cast<uint>(Notification::DismissedByUser)));
+    QTRY_COMPARE(firstClosed.count(), 1);
+    QCOMPARE(firstClosed.first().first().toUInt(), static_cast<uint>(Notification::DismissedByUser));
+    QCOMPARE(secondClosed.count(), 0);
+    QCOMPARE(unpublishedClosed.count(), 0);
+}
+
+void ut_notification::internAcrossThreads()
+{
+    // Application names and icons are interned in a pool shared by every thread
+    QString results[4];
+    for (int i = 0; i < 4; ++i) {
+        QThreadPool::globalInstance()->start(new NotificationCreator(i, &results[i]));
+    }
+    QThreadPool::globalInstance()->waitForDone();
+    for (const QString &result : results) {
+        QCOMPARE(result, QStringLiteral("ok"));
+    }
+}
+
+void ut_notification::benchmarkIdleConstruction()
+{
+    QBENCHMARK {
+        Notification notification;
+        notification.setAppName(QStringLiteral("ut_notification"));
+        notification.setCategory(QStringLiteral("x-nemo.test"));
+        notification.setSummary(QStringLiteral("idle"));
+    }
+}
+
+void ut_notification::constructionWithoutBusActivity()
+{
+    const QDBusConnection conn(newConnection());
+    NotificationConnectionManager *manager = NotificationConnectionManager::instance(conn);
+
+    {
+        // Declaring and configuring a notification, as a QML item does, does not touch the bus
+        Notification notification;
+        QVERIFY(notification.setDBusConnection(conn));
+        notification.setAppName(QStringLiteral("ut_notification"));
+        notification.setCategory(QStringLiteral("x-nemo.test"));
+        notification.setSummary(QStringLiteral("unpublished"));
+        notification.setUrgency(Notification::Critical);
+        notification.setReplacesId(0);
+    }
+    QVERIFY(manager->proxy.isNull());
+    QCOMPARE(m_server->service()->callCount(), 0);
+
+    // Signals for an existing notification arrive through the proxy, so it is created for one
+    Notification existing;
+    QVERIFY(existing.setDBusConnection(conn));
+    existing.setReplacesId(m_server->service()->insert(NotificationData()));
+    QVERIFY(!manager->proxy.isNull());
+
+    Notification published;
+    QVERIFY(published.setDBusConnection(conn));
+    published.setSummary(QStringLiteral("published"));
+    published.publish();
+    QCOMPARE(m_server->service()->callCount(QStringLiteral("Notify")), 1);
+}
+
+void ut_notification::benchmarkBoundConstruction()
+{
+    const QDBusConnection conn(newConnection());
+
+    QBENCHMARK {
+        Notification notification;
+        notification.setDBusConnection(conn);
+        notification.setAppName(QStringLiteral("ut_notification"));
+        notification.setCategory(QStringLiteral("x-nemo.test"));
+        notification.setSummary(QStringLiteral("unpublished"));
+    }
+
+    QVERIFY(NotificationConnectionManager::instance(conn)->proxy.isNull());
+    QCOMPARE(m_server->service()->callCount(), 0);
+}
+
+void ut_notification::groupedSummary()
+{
+    const QDBusConnection conn(newConnection());
+    NotificationConnectionManager *manager = NotificationConnectionManager::instance(conn);
+    manager->setGroupingWindow(0);
+
+    QList<Notification *> members;
+    for (int i = 0; i < 3; ++i) {
+        Notification *member = new Notification(this);
+        QVERIFY(member->setDBusConnection(conn));
+        member->setGroupId(QStringLiteral("messages"));
+        member->setSummary(QStringLiteral("message %1").arg(i));
+        member->setItemCount(i + 1);
+        member->publish();
+        members.append(member);
+    }
+
+    // Every member is represented by the one summary, which counts all of their items
+    const uint id = members.first()->replacesId();
+    QVERIFY(id != 0);
+    for (const Notification *member : members) {
+        QCOMPARE(member->replacesId(), id);
+    }
+    QCOMPARE(m_server->service()->notifications().count(), 1);
+    QCOMPARE(m_server->service()->notification(id).hints().value(QStringLiteral("x-nemo-item-count")).toInt(), 6);
+    QCOMPARE(m_server->service()->notification(id).summary(), QStringLiteral("message 2"));
+
+    // Within the window of the last publication, updates are held and collapsed into
+    // one publication of the latest member
+    manager->setGroupingWindow(1000);
+    const int published = m_server->service()->callCount(QStringLiteral("Notify"));
+    members.first()->publish();
+    members.at(1)->setItemCount(4);
+    members.at(1)->publish();
+    members.last()->publish();
+    QCOMPARE(m_server->service()->callCount(QStringLiteral("Notify")), published);
+    QCOMPARE(manager->collapsedGroupUpdates(), 2ull);
+
+    QTRY_COMPARE(m_server->service()->callCount(QStringLiteral("Notify")), published + 1);
+    QCOMPARE(m_server->service()->notification(id).hints().value(QStringLiteral("x-nemo-item-count")).toInt(), 8);
+    QCOMPARE(m_server->service()->notification(id).summary(), QStringLiteral("message 2"));
+
+    qDeleteAll(members);
+}
+
+void ut_notification::duplicatePublishesSkipped()
+{
+    const QDBusConnection conn(newConnection());
+    NotificationConnectionManager::instance(conn)->setDuplicatePolicy(NotificationConnectionManager::SkipDuplicates);
+
+    Notification notification;
+    QVERIFY(notification.setDBusConnection(conn));
+    notification.setSummary(QStringLiteral("unchanged"));
+    notification.publish();
+    notification.publish();
+    notification.publish();
+    QCOMPARE(m_server->service()->callCount(QStringLiteral("Notify")), 1);
+
+    notification.setBody(QStringLiteral("changed"));
+    notification.publish();
+    QCOMPARE(m_server->service()->callCount(QStringLiteral("Notify")), 2);
+
+    // Once closed, the same content creates a new notification
+    notification.close();
+    notification.publish();
+    QCOMPARE(m_server->service()->callCount(QStringLiteral("Notify")), 3);
+    QVERIFY(notification.replacesId() != 0);
+}
+
+void ut_notification::publishOrdering()
+{
+    const QDBusConnection conn(newConnection());
+    NotificationConnectionManager *manager = NotificationConnectionManager::instance(conn);
+    manager->setAsynchronousPublishing(true);
+    manager->setMaxPublishesInFlight(2);
+    manager->setReservedCriticalPublishes(1);
+    m_server->service()->setReplyDelay(100);
+
+    const QStringList summaries = QStringList() << QStringLiteral("L1") << QStringLiteral("L2")
+                                                << QStringLiteral("L3") << QStringLiteral("C1");
+    QList<Notification *> notifications;
+    for (const QString &summary : summaries) {
+        Notification *notification = new Notification(this);
+        QVERIFY(notification->setDBusConnection(conn));
+        notification->setSummary(summary);
+        notification->setUrgency(summary.startsWith(QLatin1Char('C')) ? Notification::Critical : Notification::Low);
+        notification->publish();
+        notifications.append(notification);
+    }
+
+    // The critical notification uses the reserved capacity rather than waiting for L2 and L3
+    QTRY_COMPARE(manager->publishesInFlight(), 0);
+    QStringList order;
+    for (const NotificationData &data : m_server->service()->published()) {
+        order.append(data.summary());
+    }
+    QCOMPARE(order, QStringList() << QStringLiteral("L1") << QStringLiteral("C1")
+                                  << QStringLiteral("L2") << QStringLiteral("L3"));
+    for (const Notification *notification : notifications) {
+        QVERIFY(notification->replacesId() != 0);
+    }
+    QCOMPARE(manager->peakPublishQueueDepth(), 3);
+
+    qDeleteAll(notifications);
+}
+
+void ut_notification::benchmarkCriticalUnderFlood()
+{
+    const QDBusConnection conn(newConnection());
+    NotificationConnectionManager *manager = NotificationConnectionManager::instance(conn);
+    manager->setAsynchronousPublishing(true);
+    m_server->service()->setReplyDelay(20);
+
+    QList<Notification *> flood;
+    for (int i = 0; i < 100; ++i) {
+        Notification *notification = new Notification(this);
+        QVERIFY(notification->setDBusConnection(conn));
+        notification->setSummary(QStringLiteral("flood %1").arg(i));
+        notification->setUrgency(Notification::Low);
+        flood.append(notification);
+    }
+
+    // The time until a critical notification is created, while the queue is full of others
+    QBENCHMARK {
+        for (Notification *notification : flood) {
+            notification->publish();
+        }
+        Notification critical;
+        QVERIFY(critical.setDBusConnection(conn));
+        critical.setSummary(QStringLiteral("critical"));
+        critical.setUrgency(Notification::Critical);
+        critical.publish();
+        QTRY_VERIFY(critical.replacesId() != 0);
+    }
+
+    QVERIFY(manager->maxPublishWait(Notification::Critical) < manager->maxPublishWait(Notification::Low));
+
+    m_server->service()->setReplyDelay(0);
+    QTRY_COMPARE(manager->publishesInFlight(), 0);
+    qDeleteAll(flood);
+}
+
+void ut_notification::ownerSignalsFiltered()
+{
+    const QDBusConnection conn(newConnection());
+    NotificationConnectionManager *manager = NotificationConnectionManager::instance(conn);
+    m_server->service()->setCapabilities(QStringList() << QStringLiteral("x-nemo-owner-signals"));
+
+    Notification notification;
+    QVERIFY(notification.setDBusConnection(conn));
+    notification.setSummary(QStringLiteral("owned"));
+    notification.publish();
+    const uint id = notification.replacesId();
+    QVERIFY(id != 0);
+    QTRY_COMPARE(manager->subscribedOwners(), QStringList() << owner());
+
+    QSignalSpy closed(&notification, SIGNAL(closed(uint)));
+    QSignalSpy received(manager, SIGNAL(NotificationClosed(uint,uint)));
+
+    // The server also broadcasts each signal without its owner, which is no longer received
+    QMetaObject::invokeMethod(m_server->service(), "emitClosed", Qt::QueuedConnection,
+                              Q_ARG(QString, QStringLiteral("another-app")), Q_ARG(uint, id),
+                              Q_ARG(uint, static_cast<uint>(Notification::Expired)));
+    QMetaObject::invokeMethod(m_server->service(), "emitClosed", Qt::QueuedConnection,
+                              Q_ARG(QString, owner()), Q_ARG(uint, id),
+                              Q_ARG(uint, static_cast<uint>(Notification::DismissedByUser)));
+
+    // Signals arrive in order, so the first would have been delivered before the second
+    QTRY_COMPARE(closed.count(), 1);
+    QCOMPARE(closed.first().first().toUInt(), static_cast<uint>(Notification::DismissedByUser));
+    QCOMPARE(received.count(), 1);
+    QCOMPARE(notification.replacesId(), 0u);
+    QTRY_VERIFY(manager->subscribedOwners().isEmpty());
+}
+
+void ut_notification::benchmarkForeignSignals_data()
+{
+    QTest::addColumn<bool>("ownerSignals");
+
+    QTest::newRow("broadcast") << false;
+    QTest::newRow("owner") << true;
+}
+
+void ut_notification::benchmarkForeignSignals()
+{
+    QFETCH(bool, ownerSignals);
+
+    const QDBusConnection conn(newConnection());
+    NotificationConnectionManager *manager = NotificationConnectionManager::instance(conn);
+    if (ownerSignals) {
+        m_server->service()->setCapabilities(QStringList() << QStringLiteral("x-nemo-owner-signals"));
+    }
+
+    // A resident notification keeps the subscriptions in place between iterations
+    Notification resident;
+    QVERIFY(resident.setDBusConnection(conn));
+    resident.setSummary(QStringLiteral("resident"));
+    resident.publish();
+    QTRY_COMPARE(m_server->service()->callCount(QStringLiteral("GetCapabilities")), 1);
+    if (ownerSignals) {
+        QTRY_COMPARE(manager->subscribedOwners(), QStringList() << owner());
+    }
+
+    Notification notification;
+    QVERIFY(notification.setDBusConnection(conn));
+    notification.setSummary(QStringLiteral("closed"));
+    QSignalSpy closed(&notification, SIGNAL(closed(uint)));
+    QSignalSpy received(manager, SIGNAL(NotificationClosed(uint,uint)));
+
+    // The time to deliver one event of ours among a hundred for other owners
+    QBENCHMARK {
+        const int expected = closed.count() + 1;
+        notification.publish();
+        const uint id = notification.replacesId();
+        for (int i = 0; i < 100; ++i) {
+            QMetaObject::invokeMethod(m_server->service(), "emitClosed", Qt::QueuedConnection,
+                                      Q_ARG(QString, QStringLiteral("another-app")), Q_ARG(uint, id + 1 + i),
+                                      Q_ARG(uint, static_cast<uint>(Notification::Expired)));
+        }
+        QMetaObject::invokeMethod(m_server->service(), "emitClosed", Qt::QueuedConnection,
+                                  Q_ARG(QString, owner()), Q_ARG(uint, id),
+                                  Q_ARG(uint, static_cast<uint>(Notification::DismissedByUser)));
+        QTRY_COMPARE(closed.count(), expected);
+    }
+
+    // Each signal received is a wakeup; with owner signals only our own events cause one
+    qDebug() << "Signals received per event of ours:" << received.count() / closed.count();
+    if (ownerSignals) {
+        QCOMPARE(received.count(), closed.count());
+    } else {
+        QCOMPARE(received.count(), closed.count() * 101);
+    }
+}
+
+QTEST_GUILESS_MAIN(ut_notification)
+
+#include "ut_notification.moc"
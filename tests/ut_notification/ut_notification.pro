@@ -0,0 +1,4 @@
+include(../common.pri)
+
+TARGET = ut_notification
+SOURCES += ut_notification.cpp
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+
+#include "mocknotificationserver.h"
+
+#include <notification.h>
+#include <notificationtable.h>
+
+#include <QtTest>
+
+class ut_notificationdata : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+
+    void codecRoundTrip_data();
+    void codecRoundTrip();
+    void codecRejectsInvalidBuffers();
+    void bulkListing();
+    void benchmarkCodecDecode();
+    void benchmarkListing_data();
+    void benchmarkListing();
+
+private:
+    static NotificationData createData(int index, const QString &owner);
+    static void compare(const NotificationData &actual, const NotificationData &expected);
+    void populate(int count);
+
+    MockNotificationServer *m_server = nullptr;
+    int m_connections = 0;
+};
+
+void ut_notificationdata::initTestCase()
+{
+    m_server = new MockNotificationServer;
+}
+
+void ut_notificationdata::cleanupTestCase()
+{
+    delete m_server;
+}
+
+void ut_notificationdata::init()
+{
+    m_server->service()->reset();
+}
+
+NotificationData ut_notificationdata::createData(int index, const QString &owner)
+{
+    NotificationData data;
+    data.setAppName(QStringLiteral("app-%1").arg(index % 3));
+    data.setReplacesId(index + 1);
+    data.setAppIcon(QStringLiteral("icon-m-%1").arg(index % 5));
+    data.setSummary(QStringLiteral("Summary %1").arg(index));
+    data.setBody(QString::fromUtf8("Body \xc3\xa9 %1").arg(index));
+    data.setExpireTimeout(index % 2 ? -1 : 5000);
+
+    NotificationData::ActionInfo action;
+    action.name = QStringLiteral("default");
+    action.displayName = QStringLiteral("Open");
+    data.setActions(QList<NotificationData::ActionInfo>() << action);
+
+    data.setHint(QStringLiteral("x-nemo-owner"), owner);
+    data.setHint(QStringLiteral("category"), QStringLiteral("x-nemo.category-%1").arg(index % 4));
+    data.setHint(QStringLiteral("urgency"), index % 3);
+    data.setHint(QStringLiteral("x-nemo-item-count"), index % 7 + 1);
+    data.setHint(QStringLiteral("x-nemo-timestamp"),
+                 QDateTime(QDate(2020, 1, 1), QTime(0, 0), Qt::UTC).addSecs(index).toString(Qt::ISODate));
+    data.setHint(QStringLiteral("x-nemo-remote-action-default"),
+                 QStringLiteral("com.example /example com.example.Interface open"));
+    if (index % 2) {
+        data.setHint(QStringLiteral("x-test-custom"), QVariantList() << index << QStringLiteral("custom"));
+    }
+    return data;
+}
+
+void ut_notificationdata::compare(const NotificationData &actual, const NotificationData &expected)
+{
+    QCOMPARE(actual.appName(), expected.appName());
+    QCOMPARE(actual.replacesId(), expected.replacesId());
+    QCOMPARE(actual.appIcon(), expected.appIcon());
+    QCOMPARE(actual.summary(), expected.summary());
+    QCOMPARE(actual.body(), expected.body());
+    QCOMPARE(actual.expireTimeout(), expected.expireTimeout());
+    QCOMPARE(actual.actions().count(), expected.actions().count());
+    for (int i = 0; i < actual.actions().count(); ++i) {
+        QCOMPARE(actual.actions().at(i).name, expected.actions().at(i).name);
+        QCOMPARE(actual.actions().at(i).displayName, expected.actions().at(i).displayName);
+    }
+    QCOMPARE(actual.hints(), expected.hints());
+}
+
+void ut_notificationdata::populate(int count)
+{
+    const QString owner(QCoreApplication::applicationName());
+    for (int i = 0; i < count; ++i) {
+        m_server->service()->insert(createData(i, owner));
+    }
+}
+
+void ut_notificationdata::codecRoundTrip_data()
+{
+    QTest::addColumn<int>("mode");
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("empty") << static_cast<int>(NotificationDataCodec::CopyStrings) << 0;
+    QTest::newRow("copy") << static_cast<int>(NotificationDataCodec::CopyStrings) << 50;
+    QTest::newRow("reference") << static_cast<int>(NotificationDataCodec::ReferenceStrings) << 50;
+}
+
+void ut_notificationdata::codecRoundTrip()
+{
+    QFETCH(int, mode);
+    QFETCH(int, count);
+
+    QList<NotificationData> notifications;
+    for (int i = 0; i < count; ++i) {
+        notifications.append(createData(i, QStringLiteral("owner")));
+    }
+    // A notification with nothing set
+    notifications.append(NotificationData());
+
+    const QByteArray buffer(NotificationDataCodec::encode(notifications));
+    QList<NotificationData> decoded;
+    QVERIFY(NotificationDataCodec::decode(buffer, &decoded, static_cast<NotificationDataCodec::StringMode>(mode)));
+    QCOMPARE(decoded.count(), notifications.count());
+    for (int i = 0; i < decoded.count(); ++i) {
+        compare(decoded.at(i), notifications.at(i));
+    }
+
+    // Encoding is deterministic, so equal content has equal encodings
+    QCOMPARE(NotificationDataCodec::encode(decoded), buffer);
+}
+
+void ut_notificationdata::codecRejectsInvalidBuffers()
+{
+    const QByteArray buffer(NotificationDataCodec::encode(QList<NotificationData>() << createData(1, QStringLiteral("owner"))));
+
+    QList<NotificationData> decoded;
+    QVERIFY(!NotificationDataCodec::decode(QByteArray(), &decoded));
+    QVERIFY(!NotificationDataCodec::decode(QByteArray("not a notification"), &decoded));
+    QVERIFY(!NotificationDataCodec::decode(buffer.left(buffer.size() / 2), &decoded));
+    QVERIFY(decoded.isEmpty());
+}
+
+void ut_notificationdata::bulkListing()
+{
+    const int count = 200;
+    populate(count);
+    const QDBusConnection conn(m_server->connectClient(QStringLiteral("ut_notificationdata-%1").arg(++m_connections)));
+
+    const QList<QObject *> listed(Notification::notifications(QCoreApplication::applicationName(), conn));
+    QCOMPARE(listed.count(), count);
+
+    QHash<uint, const Notification *> byId;
+    for (const QObject *object : listed) {
+        const Notification *notification = qobject_cast<const Notification *>(object);
+        QVERIFY(notification);
+        byId.insert(notification->replacesId(), notification);
+    }
+    for (int i = 0; i < count; ++i) {
+        const NotificationData expected(createData(i, QCoreApplication::applicationName()));
+        const Notification *notification = byId.value(expected.replacesId());
+        QVERIFY(notification);
+        QCOMPARE(notification->appName(), expected.appName());
+        QCOMPARE(notification->summary(), expected.summary());
+        QCOMPARE(notification->body(), expected.body());
+        QCOMPARE(notification->category(), expected.hints().value(QStringLiteral("category")).toString());
+        QCOMPARE(notification->itemCount(), expected.hints().value(QStringLiteral("x-nemo-item-count")).toInt());
+        QCOMPARE(static_cast<int>(notification->urgency()), expected.hints().value(QStringLiteral("urgency")).toInt());
+    }
+    qDeleteAll(listed);
+
+    const NotificationTable table(NotificationTable::notifications(QCoreApplication::applicationName(), conn));
+    QCOMPARE(table.count(), count);
+}
+
+void ut_notificationdata::benchmarkCodecDecode()
+{
+    QList<NotificationData> notifications;
+    for (int i = 0; i < 500; ++i) {
+        notifications.append(createData(i, QStringLiteral("owner")));
+    }
+    const QByteArray buffer(NotificationDataCodec::encode(notifications));
+
+    QBENCHMARK {
+        QList<NotificationData> decoded;
+        NotificationDataCodec::decode(buffer, &decoded, NotificationDataCodec::ReferenceStrings);
+    }
+}
+
+void ut_notificationdata::benchmarkListing_data()
+{
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("10") << 10;
+    QTest::newRow("500") << 500;
+}
+
+void ut_notificationdata::benchmarkListing()
+{
+    QFETCH(int, count);
+    populate(count);
+    const QDBusConnection conn(m_server->connectClient(QStringLiteral("ut_notificationdata-%1").arg(++m_connections)));
+
+    QBENCHMARK {
+        const QList<QObject *> listed(Notification::notifications(QCoreApplication::applicationName(), conn));
+        qDeleteAll(listed);
+    }
+}
+
+QTEST_GUILESS_MAIN(ut_notificationdata)
+
+#include "ut_notificationdata.moc"
@@ -0,0 +1,4 @@
+include(../common.pri)
+
+TARGET = ut_notificationdata
+SOURCES += ut_notificationdata.cpp